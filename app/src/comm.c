@@ -27,6 +27,7 @@ static K_EVENT_DEFINE(rx_events);
 // RX event definitions
 #define RX_EVENT_COMMAND_RECEIVED BIT(0)
 #define RX_EVENT_BACKSPACE BIT(1)
+#define RX_EVENT_CANCEL BIT(2)
 
 // TX buffer and state
 static uint8_t tx_buffer[256];
@@ -35,6 +36,11 @@ static volatile int tx_len = 0;
 static volatile int tx_pos = 0;
 static K_SEM_DEFINE(tx_done, 1, 1);
 
+// Sequence number of streamed command being executed (0: none)
+static int stream_seq = 0;
+// Set when error is printed
+static bool err_printed = false;
+
 // UART interrupt handler
 static void uart_isr(const struct device* dev, void* user_data) {
   uart_irq_update(dev);
@@ -49,6 +55,7 @@ static void uart_isr(const struct device* dev, void* user_data) {
           // Special case: cancel
           if (state_machine_get_state() != STATE_IDLE) {
             g_cancel_requested = true;
+            k_event_post(&rx_events, RX_EVENT_CANCEL);
           }
           // Reset command buffer
           rx_pos = 0;
@@ -124,7 +131,13 @@ static void send_state_prefix(const char* message_type) {
       uart_write((const uint8_t*)">", 1);
       break;
     case STATE_EXEC_STREAM:
-      uart_write((const uint8_t*)"@", 1);
+      if (stream_seq > 0) {
+        char prefix[16];
+        int len = snprintf(prefix, sizeof(prefix), "@%d", stream_seq);
+        uart_write((const uint8_t*)prefix, len);
+      } else {
+        uart_write((const uint8_t*)"@", 1);
+      }
       break;
   }
 
@@ -162,6 +175,7 @@ void comm_print_ack() {
 }
 
 void comm_print_err(const char* fmt, ...) {
+  err_printed = true;
   send_state_prefix("err ");
 
   // Format and send message
@@ -175,12 +189,41 @@ void comm_print_err(const char* fmt, ...) {
   uart_write(LINE_ENDING, LINE_ENDING_LEN);
 }
 
+void comm_set_stream_seq(int seq) {
+  stream_seq = seq;
+}
+
+void comm_print_stream_rem(int num) {
+  char buffer[32];
+  int len = snprintf(buffer, sizeof(buffer), "@rem %d", num);
+  uart_write((const uint8_t*)buffer, len);
+  uart_write(LINE_ENDING, LINE_ENDING_LEN);
+}
+
+void comm_clear_err() {
+  err_printed = false;
+}
+
+bool comm_has_err() {
+  return err_printed;
+}
+
 void comm_get_next_command(char* buffer) {
   while (1) {
     // Wait for RX events
-    uint32_t events =
-        k_event_wait(&rx_events, RX_EVENT_COMMAND_RECEIVED | RX_EVENT_BACKSPACE,
-                     false, K_FOREVER);
+    uint32_t events = k_event_wait(
+        &rx_events,
+        RX_EVENT_COMMAND_RECEIVED | RX_EVENT_BACKSPACE | RX_EVENT_CANCEL,
+        false, K_FOREVER);
+
+    if (events & RX_EVENT_CANCEL) {
+      k_event_clear(&rx_events, RX_EVENT_CANCEL);
+      if (g_machine_state == STATE_EXEC_STREAM) {
+        buffer[0] = '\0';
+        return;
+      }
+      continue;
+    }
 
     if (events & RX_EVENT_BACKSPACE) {
       k_event_clear(&rx_events, RX_EVENT_BACKSPACE);
@@ -200,8 +243,8 @@ void comm_get_next_command(char* buffer) {
         trimmed++;
       }
 
-      // Only accept commands in IDLE state
-      if (g_machine_state != STATE_IDLE) {
+      // Only accept commands in IDLE or EXEC_STREAM state
+      if (g_machine_state == STATE_EXEC_INTERACTIVE) {
         continue;  // Silently ignore
       }
 
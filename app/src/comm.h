@@ -11,6 +11,7 @@
  */
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /** (blocking) Initialize communication subsystem */
@@ -25,6 +26,21 @@ void comm_print_ack();
 /** (blocking) Print error message. */
 void comm_print_err(const char* fmt, ...);
 
+/**
+ * Set sequence number of the streamed command being executed, which is
+ * printed in EXEC_STREAM messages (e.g. "@5err ..."). 0 means no command.
+ */
+void comm_set_stream_seq(int seq);
+
+/** (blocking) Print number of streamed commands that can be sent ("@rem"). */
+void comm_print_stream_rem(int num);
+
+/** Forget previously printed errors. */
+void comm_clear_err();
+
+/** True if an error was printed since the last comm_clear_err(). */
+bool comm_has_err();
+
 /**
  * (blocking) Print blob as base64 with checksum in one big line.
  *
@@ -40,8 +56,9 @@ void comm_print_blob(uint8_t* ptr, int size);
  * Buffer must be at least 256 bytes
  *
  * Note 1: this will not return "!". Instead, it's processed internally
- * and sets g_cancel_requested, then waits for the next command.
+ * and sets g_cancel_requested. In EXEC_STREAM, it returns "" on cancel, so
+ * that the stream can be ended. Otherwise, it waits for the next command.
  *
- * Note 2: Commands that come in non-IDLE states are silently ignored.
+ * Note 2: Commands that come in EXEC_INTERACTIVE are silently ignored.
  */
 void comm_get_next_command(char* buffer);
@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "edm_base.h"
+
+#include <math.h>
+
+float edm_gap_signal(float open_rate, float short_rate) {
+  return (open_rate - short_rate) / 255.0f;
+}
+
+float edm_ignition_signal(float t_ign_us, float ref_us) {
+  return fminf(fmaxf((t_ign_us - ref_us) / ref_us, -1), 1);
+}
+
+float edm_feedback_signal(const edm_servo_cfg_t* cfg, const gap_est_t* est) {
+  switch (est->state) {
+    case GAP_OPEN:
+      return 1;
+    case GAP_SHORT:
+    case GAP_ARC:
+      return -1;
+    case GAP_NORMAL:
+      break;
+  }
+  if (cfg->feedback == EDM_FEEDBACK_IGNITION && est->has_ign) {
+    return edm_ignition_signal(est->t_ign_us, cfg->ign_ref_us);
+  }
+  return edm_gap_signal(est->r_open, est->r_short);
+}
+
+void edm_servo_init(edm_servo_t* sv, float vel) {
+  *sv = (edm_servo_t){.vel = vel};
+}
+
+float edm_servo_step(edm_servo_t* sv,
+                     const edm_servo_cfg_t* cfg,
+                     float gap,
+                     bool new_poll,
+                     float dt) {
+  // Derivative over the poll interval: differencing every step would spike
+  // at polls, and be 0 in between. Taken from gap rather than error, so that
+  // setpoint changes (e.g. by ESC) don't kick.
+  sv->t_poll += dt;
+  if (new_poll) {
+    sv->deriv = sv->has_prev ? (gap - sv->prev_gap) / sv->t_poll : 0;
+    sv->prev_gap = gap;
+    sv->has_prev = true;
+    sv->t_poll = 0;
+  }
+
+  float err = gap - cfg->setpoint;
+  float integral = sv->integral + err * dt;
+  float v_cmd = cfg->kp * err + cfg->ki * integral + cfg->kd * sv->deriv;
+  float v_clamped = fminf(fmaxf(v_cmd, -cfg->max_retract_vel), cfg->max_vel);
+  // Anti-windup: stop integrating while saturated in the same direction.
+  if (v_cmd == v_clamped || (v_cmd > v_clamped) != (err > 0)) {
+    sv->integral = integral;
+  }
+
+  float dv_max = cfg->max_acc * dt;
+  float v_prev = sv->vel;
+  sv->vel = fminf(fmaxf(v_clamped, v_prev - dv_max), v_prev + dv_max);
+  // Trapezoidal integration of velocity.
+  return (v_prev + sv->vel) * 0.5f * dt;
+}
+
+float edm_servo_readvance(edm_servo_t* sv,
+                          const edm_servo_cfg_t* cfg,
+                          float retract_mm,
+                          float d,
+                          float dt) {
+  float fast_mm = retract_mm - cfg->slow_zone_mm;
+  if (fast_mm <= 0 || cfg->readvance_vel <= 0) {
+    sv->readvancing = false;
+    sv->readvance_vel = 0;
+    return d;
+  }
+
+  float v;
+  if (d > 0) {
+    // Ramp up by max_acc.
+    v = fminf(sv->readvance_vel + cfg->max_acc * dt, cfg->readvance_vel);
+  } else {
+    // Servo stops or retracts (e.g. short). Ramp down by max_acc until
+    // meeting the servo velocity, then hand over.
+    v = sv->readvance_vel - cfg->max_acc * dt;
+    if (!sv->readvancing || v <= sv->vel) {
+      sv->readvancing = false;
+      sv->readvance_vel = 0;
+      return d;
+    }
+  }
+  // Ramp down to stop at the slow zone.
+  v = fminf(v, sqrtf(2 * cfg->max_acc * fast_mm));
+  sv->readvancing = true;
+  sv->readvance_vel = v;
+  return fmaxf(d, fminf(v * dt, fast_mm));
+}
+
+void edm_esc_init(edm_esc_t* esc, float base, uint32_t pulse_count) {
+  *esc = (edm_esc_t){.base = base, .high = true, .count_start = pulse_count};
+}
+
+float edm_esc_step(edm_esc_t* esc,
+                   const edm_esc_cfg_t* cfg,
+                   uint32_t pulse_count,
+                   float dt) {
+  esc->t += dt;
+  float half_s = cfg->period_s * 0.5f;
+  if (esc->t >= half_s) {
+    float rate = (float)(pulse_count - esc->count_start) / esc->t;
+    if (esc->high) {
+      esc->rate_high = rate;
+    } else {
+      esc->rate_low = rate;
+      // Period completed: move towards the side with more pulses.
+      // Normalized by total rate, so that gain doesn't depend on the rate.
+      float total = esc->rate_high + esc->rate_low;
+      if (total > 0) {
+        float grad = (esc->rate_high - esc->rate_low) / total;
+        esc->base += cfg->gain * grad;
+      }
+      esc->cycles++;
+    }
+    esc->high = !esc->high;
+    esc->t = 0;
+    esc->count_start = pulse_count;
+  }
+
+  esc->base = fminf(fmaxf(esc->base, cfg->min_base), cfg->max_base);
+  return esc->base + (esc->high ? cfg->amplitude : -cfg->amplitude);
+}
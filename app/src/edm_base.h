@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+/**
+ * (Stateless) EDM gap servo logic.
+ * No side effects, no global state - easily testable.
+ *
+ * Servo keeps the gap between electrode and work at the setpoint, by moving
+ * along the path. Gap signal is in [-1, 1]: positive when the gap is too wide
+ * (mostly open), negative when too narrow (mostly short).
+ *
+ * Gap signal comes from either of two feedback sources:
+ * - rate: balance of open & short time in the poll period
+ * - ignition: mean ignition delay relative to a reference delay. Longer delay
+ *   means wider gap. This holds narrow gaps more precisely than rates.
+ *
+ * PID output is the velocity along the path (positive: advance), clamped by
+ * velocity and acceleration limits. Gap signal only changes at pulser polls,
+ * which are slower than servo steps, so the D term is updated per poll.
+ *
+ * After retraction, the path up to the furthest point is already machined.
+ * While advancing there, re-advance moves much faster than the servo, and
+ * slows down to the servo speed before reaching the furthest point.
+ *
+ * Optionally, extremum-seeking control (ESC) tunes the servo setpoint to
+ * maximize discharge rate. It alternates the setpoint between
+ * base ± amplitude every half period, compares the number of pulses in the
+ * two halves, and moves the base towards the better side.
+ */
+#pragma once
+
+#include "gap_base.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  EDM_FEEDBACK_RATE = 0,
+  EDM_FEEDBACK_IGNITION = 1,
+} edm_feedback_t;
+
+typedef struct {
+  edm_feedback_t feedback;  // source of gap signal
+  float ign_ref_us;         // ignition delay for gap signal 0 (µs, > 0)
+  float setpoint;           // target gap signal (-1~1)
+  float kp;                 // (mm/s) / gap error
+  float ki;                 // (mm/s) / (gap error * s)
+  float kd;                 // (mm/s) / (gap error / s)
+  float max_vel;            // max advance velocity (mm/s, > 0)
+  float max_retract_vel;    // max retract velocity (mm/s, > 0)
+  float max_acc;            // max acceleration (mm/s^2, > 0)
+  float readvance_vel;      // max re-advance velocity (mm/s, 0: disabled)
+  float slow_zone_mm;       // servo speed within this from furthest point
+} edm_servo_cfg_t;
+
+typedef struct {
+  float vel;            // current velocity (mm/s, positive: advance)
+  float integral;       // integral of gap error (s)
+  float prev_gap;       // gap signal of the previous poll
+  bool has_prev;        // prev_gap is valid
+  float t_poll;         // time since the previous poll (s)
+  float deriv;          // derivative of gap signal (1/s), held between polls
+  bool readvancing;     // re-advance is overriding the servo
+  float readvance_vel;  // current re-advance velocity (mm/s)
+} edm_servo_t;
+
+typedef struct {
+  bool enabled;     // false: fixed setpoint
+  float amplitude;  // setpoint perturbation (gap signal, > 0)
+  float period_s;   // full perturbation period (s, > 0)
+  float gain;       // max base change per period (gap signal, >= 0)
+  float min_base;   // allowed range of base setpoint
+  float max_base;
+} edm_esc_cfg_t;
+
+typedef struct {
+  float base;            // center of setpoint
+  bool high;             // in the half of base + amplitude
+  float t;               // time since start of the half (s)
+  uint32_t count_start;  // pulse count at start of the half
+  float rate_high;       // pulse rate of the latest high half (pulses/s)
+  float rate_low;        // pulse rate of the latest low half (pulses/s)
+  int cycles;            // number of completed periods
+} edm_esc_t;
+
+/** Gap signal from short & open rates (0-255). */
+float edm_gap_signal(float open_rate, float short_rate);
+
+/** Gap signal from mean ignition delay (µs). */
+float edm_ignition_signal(float t_ign_us, float ref_us);
+
+/**
+ * Gap signal of estimated gap from the configured feedback source.
+ * Open gap gives 1, and short or arc gives -1 (full retraction). Otherwise,
+ * the signal is proportional to the smoothed feedback.
+ * Ignition delay is undefined without pulses, so rates are used until pulses
+ * are seen.
+ */
+float edm_feedback_signal(const edm_servo_cfg_t* cfg, const gap_est_t* est);
+
+/** Reset controller, starting from vel (mm/s). */
+void edm_servo_init(edm_servo_t* sv, float vel);
+
+/**
+ * Update controller with the latest gap signal.
+ *
+ * @param new_poll gap is from a poll newer than the previous step
+ * @param dt time since the previous step (s, > 0)
+ * @return distance to move in this step (mm, positive: advance)
+ */
+float edm_servo_step(edm_servo_t* sv,
+                     const edm_servo_cfg_t* cfg,
+                     float gap,
+                     bool new_poll,
+                     float dt);
+
+/**
+ * Speed up servo advance while retracted. Call after edm_servo_step().
+ *
+ * @param retract_mm distance behind the furthest point (mm, >= 0)
+ * @param d distance returned by edm_servo_step() (mm)
+ * @return distance to move in this step (mm). Same as d within slow zone, or
+ * if re-advance is disabled. When the servo stops advancing (e.g. short),
+ * re-advance slows down by max_acc to the servo velocity before handing over.
+ */
+float edm_servo_readvance(edm_servo_t* sv,
+                          const edm_servo_cfg_t* cfg,
+                          float retract_mm,
+                          float d,
+                          float dt);
+
+/**
+ * Reset ESC around base setpoint.
+ *
+ * @param pulse_count current cumulative pulse count
+ */
+void edm_esc_init(edm_esc_t* esc, float base, uint32_t pulse_count);
+
+/**
+ * Advance ESC by dt.
+ *
+ * @param pulse_count cumulative pulse count (can wrap around)
+ * @return setpoint to use in this step
+ */
+float edm_esc_step(edm_esc_t* esc,
+                   const edm_esc_cfg_t* cfg,
+                   uint32_t pulse_count,
+                   float dt);
@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "gap_base.h"
+
+static float ewma(float prev, float sample, float alpha) {
+  return prev + (sample - prev) * alpha;
+}
+
+void gap_est_init(gap_est_t* est) {
+  *est = (gap_est_t){.state = GAP_NORMAL};
+}
+
+// True if smoothed values look like arcing.
+static bool is_arcing(const gap_est_t* est, const gap_cfg_t* cfg) {
+  // Continuous discharge without pulse completion also counts as arcing.
+  float discharge_us = est->r_pulse / 255.0f * GAP_POLL_US;
+  return discharge_us > cfg->arc_pulse_us * est->n_pulse;
+}
+
+void gap_est_update(gap_est_t* est,
+                    const gap_cfg_t* cfg,
+                    const gap_poll_t* poll) {
+  // First sample initializes the filter directly, to avoid slow start from 0.
+  float alpha = est->has_sample ? cfg->alpha : 1;
+  est->n_pulse = ewma(est->n_pulse, poll->n_pulse, alpha);
+  est->r_pulse = ewma(est->r_pulse, poll->r_pulse, alpha);
+  est->r_short = ewma(est->r_short, poll->r_short, alpha);
+  est->r_open = ewma(est->r_open, poll->r_open, alpha);
+  est->has_sample = true;
+  est->polls++;
+  if (poll->n_pulse > 0) {
+    float alpha_ign = est->has_ign ? cfg->alpha : 1;
+    est->t_ign_us = ewma(est->t_ign_us, poll->t_ign_us, alpha_ign);
+    est->has_ign = true;
+  }
+
+  if (is_arcing(est, cfg)) {
+    if (est->arc_count < cfg->arc_polls) {
+      est->arc_count++;
+    }
+  } else if (est->arc_count > 0) {
+    est->arc_count--;
+  }
+
+  float enter = cfg->enter_rate * 255;
+  float exit = cfg->exit_rate * 255;
+  switch (est->state) {
+    case GAP_ARC:
+      if (est->arc_count == 0) {
+        est->state = GAP_NORMAL;
+      }
+      break;
+    case GAP_SHORT:
+      if (est->r_short < exit) {
+        est->state = GAP_NORMAL;
+      }
+      break;
+    case GAP_OPEN:
+      if (est->r_open < exit) {
+        est->state = GAP_NORMAL;
+      }
+      break;
+    case GAP_NORMAL:
+      break;
+  }
+
+  // Arc is the most harmful, so it takes precedence.
+  if (est->state != GAP_ARC && est->arc_count >= cfg->arc_polls) {
+    est->state = GAP_ARC;
+  } else if (est->state == GAP_NORMAL) {
+    if (est->r_short >= enter) {
+      est->state = GAP_SHORT;
+    } else if (est->r_open >= enter) {
+      est->state = GAP_OPEN;
+    }
+  }
+}
+
+const char* gap_state_name(gap_state_t state) {
+  switch (state) {
+    case GAP_NORMAL:
+      return "normal";
+    case GAP_OPEN:
+      return "open";
+    case GAP_SHORT:
+      return "short";
+    case GAP_ARC:
+      return "arc";
+  }
+  return "?";
+}
@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+/**
+ * (Stateless) EDM gap state estimation from the pulser poll stream.
+ * No side effects, no global state - easily testable.
+ *
+ * A single poll is noisy, so each value is smoothed by EWMA, and the gap is
+ * classified from the smoothed values with hysteresis:
+ * - open: mostly waiting for ignition (too wide)
+ * - short: mostly shorted (too narrow)
+ * - arc: discharge continues much longer per pulse than a normal pulse
+ *   (sustained arcing, which damages the work)
+ * - normal: otherwise
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// EDM poll period of the pulser (µs).
+#define GAP_POLL_US 1000
+
+typedef enum {
+  GAP_NORMAL,
+  GAP_OPEN,
+  GAP_SHORT,
+  GAP_ARC,
+} gap_state_t;
+
+/** Values read from the pulser in a poll. */
+typedef struct {
+  uint8_t n_pulse;  // number of pulses
+  uint8_t r_pulse;  // ratio spent discharging (0-255)
+  uint8_t r_short;  // ratio spent shorted (0-255)
+  uint8_t r_open;   // ratio spent waiting (0-255)
+  float t_ign_us;   // mean ignition delay (µs). Meaningless if n_pulse is 0.
+} gap_poll_t;
+
+typedef struct {
+  float alpha;         // EWMA weight of a new poll (0~1]. 1: no filtering.
+  float enter_rate;    // ratio (0~1) to enter open or short
+  float exit_rate;     // ratio (0~1) to leave open or short (<= enter_rate)
+  float arc_pulse_us;  // discharge time per pulse regarded as arcing (µs)
+  int arc_polls;       // polls of arcing needed to enter arc (>= 1)
+} gap_cfg_t;
+
+typedef struct {
+  // Smoothed poll values. Rates are in 0-255, same as the poll.
+  float n_pulse;
+  float r_pulse;
+  float r_short;
+  float r_open;
+  float t_ign_us;  // smoothed only over polls with pulses
+
+  gap_state_t state;
+  // Arcing evidence. +1 per arcing poll, -1 per other poll, in [0, arc_polls].
+  int arc_count;
+  bool has_sample;  // smoothed values are valid
+  bool has_ign;     // t_ign_us is valid
+  uint32_t polls;   // number of polls so far. Wraps around.
+} gap_est_t;
+
+void gap_est_init(gap_est_t* est);
+
+/** Update estimate with a new poll. */
+void gap_est_update(gap_est_t* est,
+                    const gap_cfg_t* cfg,
+                    const gap_poll_t* poll);
+
+/** Short name of state (e.g. "normal"). */
+const char* gap_state_name(gap_state_t state);
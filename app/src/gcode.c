@@ -11,83 +11,306 @@
 
 #include <zephyr/kernel.h>
 
+// Modal state
+static arc_plane_t arc_plane = ARC_PLANE_XY;
+// Offset of the second control point from the end of last G5, valid only if
+// the previous command was G5. Used when I/J are omitted.
+static bool prev_is_bezier = false;
+static float prev_bezier_p, prev_bezier_q;
+
+// Pushed from settings
+static float arc_tol = 0.002f;
+
+// Wait for motion completion, and report why it stopped.
+static void wait_motion_stop() {
+  while (true) {
+    if (motion_get_current_state() == MOTION_STATE_STOPPED) {
+      break;
+    }
+    k_sleep(K_MSEC(10));
+  }
+  switch (motion_get_last_stop_reason()) {
+    case STOP_REASON_TARGET_REACHED:
+      comm_print("motion completed");
+      break;
+    case STOP_REASON_STALL_DETECTED:
+      comm_print("stall detected");
+      break;
+    case STOP_REASON_PROBE_TRIGGERED:
+      comm_print("probe triggered");
+      break;
+    case STOP_REASON_HOMING_FAILED:
+      comm_print_err("homing failed: axis didn't stall within max travel");
+      break;
+    case STOP_REASON_CANCELLED:
+      comm_print(
+          "motion cancelled (for safety, pulser de-energized & wirefeed "
+          "stopped)");
+      pulser_deenergize();  // for safety
+      wirefeed_stop();      // for safety
+      break;
+    default:
+      comm_print_err("motion ended for unknown reason");
+      break;
+  }
+}
+
+// Enqueue a move, waiting while the motion is busy.
+// Returns false if cancelled before the move is accepted.
+static bool enqueue_move_blocking(pos_phys_t p, bool edm) {
+  while (!(edm ? motion_enqueue_edm_move(p) : motion_enqueue_move(p))) {
+    if (g_cancel_requested) {
+      return false;
+    }
+    k_sleep(K_MSEC(1));
+  }
+  return true;
+}
+
+// State of axis word of the command, by axis index (X, Y, Z, A, B, C).
+static axis_state_t axis_word_state(const gcode_parsed_t* parsed, int axis) {
+  const axis_state_t states[AXIS_COUNT] = {
+      parsed->x_state, parsed->y_state, parsed->z_state,
+      parsed->a_state, parsed->b_state, parsed->c_state};
+  return states[axis];
+}
+
+static bool has_axis_word(const gcode_parsed_t* parsed, axis_state_t state) {
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    if (axis_word_state(parsed, axis) == state) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Overwrite coordinates of p by axis words with values.
+static void apply_axis_words(const gcode_parsed_t* parsed, pos_phys_t* p) {
+  const float values[AXIS_COUNT] = {parsed->x, parsed->y, parsed->z,
+                                    parsed->a, parsed->b, parsed->c};
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    if (axis_word_state(parsed, axis) == AXIS_WITH_VALUE) {
+      posp_set(p, axis, values[axis]);
+    }
+  }
+}
+
 static void exec_gcode_cmd(const gcode_parsed_t* parsed) {
   if (parsed->code == 0 && parsed->sub_code == -1) {
     // G0 - rapid positioning
     // Validate: requires AXIS_WITH_VALUE, not AXIS_ONLY, and at least one axis
-    if (parsed->x_state == AXIS_ONLY || parsed->y_state == AXIS_ONLY ||
-        parsed->z_state == AXIS_ONLY) {
+    if (has_axis_word(parsed, AXIS_ONLY)) {
       comm_print_err("G0 requires axis values (e.g., X10.5), not bare axes");
       return;
     }
-    if (parsed->x_state == AXIS_NOT_SPECIFIED &&
-        parsed->y_state == AXIS_NOT_SPECIFIED &&
-        parsed->z_state == AXIS_NOT_SPECIFIED) {
+    if (!has_axis_word(parsed, AXIS_WITH_VALUE)) {
       comm_print_err("G0 requires at least one axis parameter");
       return;
     }
 
     // Execute: move to specified coordinates
-    pos_phys_t p = motion_get_current_pos();
-    if (parsed->x_state == AXIS_WITH_VALUE) {
-      p.x = parsed->x;
-    }
-    if (parsed->y_state == AXIS_WITH_VALUE) {
-      p.y = parsed->y;
-    }
-    if (parsed->z_state == AXIS_WITH_VALUE) {
-      p.z = parsed->z;
-    }
-    motion_enqueue_move(p);
+    pos_phys_t p = motion_get_end_pos();
+    apply_axis_words(parsed, &p);
+    enqueue_move_blocking(p, false);
   } else if (parsed->code == 1 && parsed->sub_code == -1) {
     // G1 - controlled EDM move
     // Same validation as G0
-    if (parsed->x_state == AXIS_ONLY || parsed->y_state == AXIS_ONLY ||
-        parsed->z_state == AXIS_ONLY) {
+    if (has_axis_word(parsed, AXIS_ONLY)) {
       comm_print_err("G1 requires axis values (e.g., X10.5), not bare axes");
       return;
     }
-    if (parsed->x_state == AXIS_NOT_SPECIFIED &&
-        parsed->y_state == AXIS_NOT_SPECIFIED &&
-        parsed->z_state == AXIS_NOT_SPECIFIED) {
+    if (!has_axis_word(parsed, AXIS_WITH_VALUE)) {
       comm_print_err("G1 requires at least one axis parameter");
       return;
     }
 
     // Execute: EDM move to specified coordinates
-    pos_phys_t p = motion_get_current_pos();
-    if (parsed->x_state == AXIS_WITH_VALUE) {
-      p.x = parsed->x;
+    pos_phys_t p = motion_get_end_pos();
+    apply_axis_words(parsed, &p);
+    enqueue_move_blocking(p, true);
+  } else if ((parsed->code == 2 || parsed->code == 3) &&
+             parsed->sub_code == -1) {
+    // G2/G3 - arc EDM move (CW/CCW)
+    // Validate: axes need values, and either I/J/K (center offset) or R
+    if (has_axis_word(parsed, AXIS_ONLY)) {
+      comm_print_err("G%d requires axis values (e.g., X10.5), not bare axes",
+                     parsed->code);
+      return;
+    }
+    bool has_offset = parsed->i_state == PARAM_SPECIFIED ||
+                      parsed->j_state == PARAM_SPECIFIED ||
+                      parsed->k_state == PARAM_SPECIFIED;
+    bool has_radius = parsed->r_state == PARAM_SPECIFIED;
+    if (has_offset == has_radius) {
+      comm_print_err("G%d requires either I/J/K or R", parsed->code);
+      return;
+    }
+
+    // Execute: generate chords of the arc
+    bool cw = (parsed->code == 2);
+    pos_phys_t start = motion_get_end_pos();
+    pos_phys_t end = start;
+    apply_axis_words(parsed, &end);
+    pos_phys_t center;
+    if (has_radius) {
+      if (!arc_center_from_radius(&start, &end, parsed->r, cw, arc_plane,
+                                  &center)) {
+        comm_print_err("G%d R is too small, or end is same as start",
+                       parsed->code);
+        return;
+      }
+    } else {
+      // unspecified offsets are 0 (parsed as 0)
+      center = start;
+      center.x = start.x + parsed->i;
+      center.y = start.y + parsed->j;
+      center.z = start.z + parsed->k;
+    }
+    arc_iter_t arc;
+    if (!arc_init(&arc, &start, &end, &center, cw, arc_plane, arc_tol)) {
+      comm_print_err("G%d end is not on the circle", parsed->code);
+      return;
     }
-    if (parsed->y_state == AXIS_WITH_VALUE) {
-      p.y = parsed->y;
+    pos_phys_t p;
+    while (arc_next(&arc, &p)) {
+      if (!enqueue_move_blocking(p, true)) {
+        break;
+      }
     }
-    if (parsed->z_state == AXIS_WITH_VALUE) {
-      p.z = parsed->z;
+  } else if (parsed->code == 5 && parsed->sub_code == -1) {
+    // G5 - cubic Bezier EDM move (XY plane)
+    // Validate: P/Q (2nd control point offset from end) are required.
+    // I/J (1st control point offset from start) can be omitted after G5, to
+    // continue smoothly from the previous curve.
+    // Failed or cancelled G5 can't be continued.
+    bool follows_bezier = prev_is_bezier;
+    prev_is_bezier = false;
+    if (arc_plane != ARC_PLANE_XY) {
+      comm_print_err("G5 requires XY plane (G17)");
+      return;
+    }
+    if (has_axis_word(parsed, AXIS_ONLY)) {
+      comm_print_err("G5 requires axis values (e.g., X10.5), not bare axes");
+      return;
+    }
+    if (parsed->p_state != PARAM_SPECIFIED ||
+        parsed->q_state != PARAM_SPECIFIED) {
+      comm_print_err("G5 requires P and Q");
+      return;
+    }
+    bool has_ij = parsed->i_state == PARAM_SPECIFIED &&
+                  parsed->j_state == PARAM_SPECIFIED;
+    bool has_i_or_j = parsed->i_state == PARAM_SPECIFIED ||
+                      parsed->j_state == PARAM_SPECIFIED;
+    if (has_i_or_j != has_ij || (!has_ij && !follows_bezier)) {
+      comm_print_err("G5 requires both I and J, unless following G5");
+      return;
     }
-    motion_enqueue_edm_move(p);
+
+    // Execute: generate chords of the curve, within a notch
+    pos_phys_t start = motion_get_end_pos();
+    pos_phys_t end = start;
+    apply_axis_words(parsed, &end);
+    float i = has_ij ? parsed->i : -prev_bezier_p;
+    float j = has_ij ? parsed->j : -prev_bezier_q;
+    pos_phys_t ctrl1 = {start.x + i, start.y + j};
+    pos_phys_t ctrl2 = {end.x + parsed->p, end.y + parsed->q};
+    // Other axes move linearly.
+    for (int axis = 2; axis < AXIS_COUNT; axis++) {
+      float third = (posp_get(&end, axis) - posp_get(&start, axis)) / 3;
+      posp_set(&ctrl1, axis, posp_get(&start, axis) + third);
+      posp_set(&ctrl2, axis, posp_get(&end, axis) - third);
+    }
+    bezier_iter_t curve;
+    bezier_init(&curve, &start, &ctrl1, &ctrl2, &end, motion_get_edm_notch());
+    pos_phys_t p;
+    bool completed = true;
+    while (bezier_next(&curve, &p)) {
+      if (!enqueue_move_blocking(p, true)) {
+        completed = false;
+        break;
+      }
+    }
+    prev_is_bezier = completed;
+    prev_bezier_p = parsed->p;
+    prev_bezier_q = parsed->q;
+  } else if (parsed->code == 17 && parsed->sub_code == -1) {
+    // G17 - select XY plane for arcs
+    arc_plane = ARC_PLANE_XY;
+    return;
+  } else if (parsed->code == 18 && parsed->sub_code == -1) {
+    // G18 - select ZX plane for arcs
+    arc_plane = ARC_PLANE_ZX;
+    return;
+  } else if (parsed->code == 19 && parsed->sub_code == -1) {
+    // G19 - select YZ plane for arcs
+    arc_plane = ARC_PLANE_YZ;
+    return;
   } else if (parsed->code == 28 && parsed->sub_code == -1) {
     // G28 - homing
-    // Validate: requires exactly one axis with AXIS_ONLY format
+    // Validate: requires at most one axis with AXIS_ONLY format
     bool x_specified = (parsed->x_state == AXIS_ONLY);
     bool y_specified = (parsed->y_state == AXIS_ONLY);
     bool z_specified = (parsed->z_state == AXIS_ONLY);
     int axis_count = x_specified + y_specified + z_specified;
 
-    if (axis_count != 1) {
+    bool has_rotary = parsed->a_state != AXIS_NOT_SPECIFIED ||
+                      parsed->b_state != AXIS_NOT_SPECIFIED ||
+                      parsed->c_state != AXIS_NOT_SPECIFIED;
+    if (axis_count > 1 || has_axis_word(parsed, AXIS_WITH_VALUE) ||
+        has_rotary) {
       comm_print_err(
-          "G28 requires exactly one axis without value (X, Y, or Z)");
+          "G28 requires at most one axis without value (X, Y, or Z)");
+      return;
+    }
+
+    if (axis_count == 0) {
+      // Home all axes, phase by phase
+      for (int phase = 0; phase <= MOTION_MAX_HOME_PHASE; phase++) {
+        int axes = 0;
+        for (int axis = 0; axis < MOTION_HOME_AXIS_COUNT; axis++) {
+          if (motion_get_home_phase(axis) == phase) {
+            axes |= BIT(axis);
+          }
+        }
+        if (axes == 0) {
+          continue;
+        }
+        if (!motion_enqueue_home(axes)) {
+          comm_print_err("G28: motion busy");
+          return;
+        }
+        wait_motion_stop();
+        if (motion_get_last_stop_reason() != STOP_REASON_STALL_DETECTED) {
+          comm_print_err("G28 aborted at phase %d", phase);
+          return;
+        }
+      }
       return;
     }
 
     // Execute: home the specified axis
-    if (x_specified) {
-      motion_enqueue_home(0);  // Home X axis
-    } else if (y_specified) {
-      motion_enqueue_home(1);  // Home Y axis
-    } else if (z_specified) {
-      motion_enqueue_home(2);  // Home Z axis
+    int axis = x_specified ? 0 : (y_specified ? 1 : 2);
+    if (!motion_enqueue_home(BIT(axis))) {
+      comm_print_err("G28: motion busy");
+      return;
     }
+  } else if (parsed->code == 61 && parsed->sub_code == -1) {
+    // G61 - exact stop mode
+    motion_set_corner_tol(0);
+    return;
+  } else if (parsed->code == 64 && parsed->sub_code == -1) {
+    // G64 - continuous path mode
+    // Validate: P (corner tolerance in mm) is optional
+    float tol = (parsed->p_state == PARAM_SPECIFIED)
+                    ? parsed->p
+                    : MOTION_DEFAULT_CORNER_TOL_MM;
+    if (tol < 0) {
+      comm_print_err("G64 P must be non-negative");
+      return;
+    }
+    motion_set_corner_tol(tol);
+    return;
   } else {
     if (parsed->sub_code != -1) {
       comm_print_err("Unsupported G-code: G%d.%d", parsed->code,
@@ -98,34 +321,12 @@ static void exec_gcode_cmd(const gcode_parsed_t* parsed) {
     return;
   }
 
-  // Wait for motion completion
-  while (true) {
-    if (motion_get_current_state() == MOTION_STATE_STOPPED) {
-      break;
-    }
-    k_sleep(K_MSEC(10));
-  }
-  switch (motion_get_last_stop_reason()) {
-    case STOP_REASON_TARGET_REACHED:
-      comm_print("motion completed");
-      break;
-    case STOP_REASON_STALL_DETECTED:
-      comm_print("stall detected");
-      break;
-    case STOP_REASON_PROBE_TRIGGERED:
-      comm_print("probe triggered");
-      break;
-    case STOP_REASON_CANCELLED:
-      comm_print(
-          "motion cancelled (for safety, pulser de-energized & wirefeed "
-          "stopped)");
-      pulser_deenergize();  // for safety
-      wirefeed_stop();      // for safety
-      break;
-    default:
-      comm_print_err("motion ended for unknown reason");
-      break;
+  // When streaming, return as soon as the move is accepted, so that next move
+  // can be joined without stopping.
+  if (g_machine_state == STATE_EXEC_STREAM && gcode_is_path_move(parsed)) {
+    return;
   }
+  wait_motion_stop();
 }
 
 static void exec_mcode_cmd(const gcode_parsed_t* parsed) {
@@ -176,13 +377,37 @@ static void exec_mcode_cmd(const gcode_parsed_t* parsed) {
 void exec_gcode(char* full_command) {
   gcode_parsed_t parsed;
   if (!parse_gcode(full_command, &parsed)) {
+    prev_is_bezier = false;
     comm_print_err("Failed to parse G/M-code: %s", full_command);
     return;
   }
 
+  // Moves can overlap with each other (when streaming), but anything else
+  // should wait for preceding motion to complete.
+  if (!gcode_is_path_move(&parsed) &&
+      motion_get_current_state() != MOTION_STATE_STOPPED) {
+    wait_motion_stop();
+  }
+
+  // G5 itself sets prev_is_bezier, only when it completes.
+  bool is_bezier = parsed.cmd_type == CMD_TYPE_G && parsed.code == 5 &&
+                   parsed.sub_code == -1;
+  if (!is_bezier) {
+    prev_is_bezier = false;
+  }
   if (parsed.cmd_type == CMD_TYPE_G) {
     exec_gcode_cmd(&parsed);
   } else if (parsed.cmd_type == CMD_TYPE_M) {
     exec_mcode_cmd(&parsed);
   }
 }
+
+void gcode_wait_moves() {
+  if (motion_get_current_state() != MOTION_STATE_STOPPED) {
+    wait_motion_stop();
+  }
+}
+
+void gcode_set_arc_tol(float tol_mm) {
+  arc_tol = tol_mm;
+}
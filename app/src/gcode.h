@@ -10,3 +10,14 @@
  * @param full_command The complete G/M-code command string
  */
 void exec_gcode(char* full_command);
+
+/**
+ * (blocking) Wait until moves left running by streamed commands are done.
+ * Call at the end of a stream.
+ */
+void gcode_wait_moves();
+
+/** Set max deviation of chords from G2/G3 arcs (mm).
+ * Called by settings system.
+ */
+void gcode_set_arc_tol(float tol_mm);
@@ -127,8 +127,34 @@ bool parse_gcode(const char* line, gcode_parsed_t* parsed) {
       if (!parse_axis_param(token, 'Z', &parsed->z_state, &parsed->z)) {
         return false;
       }
+    } else if (param == 'A') {
+      if (!parse_axis_param(token, 'A', &parsed->a_state, &parsed->a)) {
+        return false;
+      }
+    } else if (param == 'B') {
+      if (!parse_axis_param(token, 'B', &parsed->b_state, &parsed->b)) {
+        return false;
+      }
+    } else if (param == 'C') {
+      if (!parse_axis_param(token, 'C', &parsed->c_state, &parsed->c)) {
+        return false;
+      }
     }
-    // Try P/Q/R parameters (for M-codes)
+    // Try I/J/K parameters (for arcs)
+    else if (param == 'I') {
+      if (!parse_param(token, 'I', &parsed->i_state, &parsed->i)) {
+        return false;
+      }
+    } else if (param == 'J') {
+      if (!parse_param(token, 'J', &parsed->j_state, &parsed->j)) {
+        return false;
+      }
+    } else if (param == 'K') {
+      if (!parse_param(token, 'K', &parsed->k_state, &parsed->k)) {
+        return false;
+      }
+    }
+    // Try P/Q/R parameters
     else if (param == 'P') {
       if (!parse_param(token, 'P', &parsed->p_state, &parsed->p)) {
         return false;
@@ -148,3 +174,10 @@ bool parse_gcode(const char* line, gcode_parsed_t* parsed) {
 
   return true;
 }
+
+bool gcode_is_path_move(const gcode_parsed_t* parsed) {
+  if (parsed->cmd_type != CMD_TYPE_G || parsed->sub_code != -1) {
+    return false;
+  }
+  return (parsed->code >= 0 && parsed->code <= 3) || parsed->code == 5;
+}
@@ -45,8 +45,14 @@ typedef struct {
   // Axis parameters (G-codes)
   axis_state_t x_state, y_state, z_state;
   float x, y, z;
+  axis_state_t a_state, b_state, c_state;  // rotary axes
+  float a, b, c;
 
-  // M-code parameters
+  // Arc center offset parameters (G2/G3)
+  param_state_t i_state, j_state, k_state;
+  float i, j, k;
+
+  // Other parameters (M-codes, G64, G2/G3 radius)
   param_state_t p_state, q_state, r_state;
   float p, q, r;
 } gcode_parsed_t;
@@ -58,3 +64,9 @@ typedef struct {
  * @return true if parsing succeeded, false on error
  */
 bool parse_gcode(const char* line, gcode_parsed_t* parsed);
+
+/**
+ * Check if command is a path move (G0, G1, G2, G3, G5).
+ * Consecutive path moves can be joined without stopping.
+ */
+bool gcode_is_path_move(const gcode_parsed_t* parsed);
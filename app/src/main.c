@@ -8,12 +8,14 @@
 #include "gcode.h"
 #include "motion.h"
 #include "motor.h"
+#include "nvstore.h"
 #include "pulser.h"
 #include "settings.h"
 #include "strutil.h"
 #include "system.h"
 #include "wirefeed.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <zephyr/kernel.h>
@@ -25,8 +27,12 @@ static uint32_t download_buffer_size = 0;
 static void cmd_help(char* args) {
   comm_print("help - Show this help");
   comm_print(
-      "stat <subsystem> - Show subsystem status (motor, pulser, wirefeed)");
+      "stat <subsystem> - Show subsystem status (motion, motor, pulser, "
+      "wirefeed)");
   comm_print("steptest <motor_num> - Step motor test (0, 1, or 2)");
+  comm_print("sgcal <axis> - Calibrate stall threshold (x, y, or z)");
+  comm_print("homesave - Save position to flash, to restore after reset");
+  comm_print("homeok - Restore position saved before reset (skip homing)");
   comm_print("set <key> <value> - Set variable to value");
   comm_print("get - List all variables with values");
   comm_print("get <key> - Get specific variable value");
@@ -100,11 +106,13 @@ static void cmd_get(char* args) {
 static void cmd_stat(char* args) {
   if (!args || strlen(args) == 0) {
     comm_print_err("Usage: stat <subsystem>");
-    comm_print("Available subsystems: motor, pulser, wirefeed");
+    comm_print("Available subsystems: motion, motor, pulser, wirefeed");
     return;
   }
 
-  if (strcmp(args, "motor") == 0) {
+  if (strcmp(args, "motion") == 0) {
+    motion_dump_status();
+  } else if (strcmp(args, "motor") == 0) {
     motor_dump_status();
   } else if (strcmp(args, "pulser") == 0) {
     pulser_dump_status();
@@ -131,6 +139,58 @@ static void cmd_steptest(char* args) {
   motor_run_steptest(motor_num);
 }
 
+// Command: sgcal
+static void cmd_sgcal(char* args) {
+  const char* axis_names[] = {"x", "y", "z"};
+  int axis = -1;
+  for (int i = 0; i < 3; i++) {
+    if (args && strcmp(args, axis_names[i]) == 0) {
+      axis = i;
+    }
+  }
+  if (axis < 0) {
+    comm_print_err("Usage: sgcal <axis>");
+    return;
+  }
+
+  // Axis N is driven by motor N.
+  char key[16];
+  snprintf(key, sizeof(key), "m.%d.thresh", axis);
+  float prev_thresh = settings_get(key);
+
+  int thresh = motion_calibrate_stallguard(axis);
+  if (thresh < 0) {
+    settings_set(key, prev_thresh);  // restore swept register
+    comm_print_err("sgcal failed: %d", thresh);
+    return;
+  }
+  if (!settings_set(key, thresh)) {
+    comm_print_err("Failed to set %s", key);
+    return;
+  }
+  comm_print("%s %d", key, thresh);
+}
+
+// Command: homesave
+static void cmd_homesave(char* args) {
+  // Flash write stalls the CPU, which would disturb running EDM.
+  if (pulser_is_energized() || wirefeed_is_feeding()) {
+    comm_print_err("Stop pulser (M5) & wirefeed (M11) before homesave");
+    return;
+  }
+  if (!motion_save_home()) {
+    comm_print_err(
+        "Position not saved; needs all axes homed & held (m.N.idlems < 0)");
+  }
+}
+
+// Command: homeok
+static void cmd_homeok(char* args) {
+  if (!motion_restore_home()) {
+    comm_print_err("No restorable position; home with G28");
+  }
+}
+
 // Command: download
 static void cmd_download(char* args) {
   // Copy EDM log data to download buffer
@@ -148,12 +208,33 @@ static void cmd_download(char* args) {
   comm_print_blob(download_buffer, download_buffer_size);
 }
 
+// Print IDLE state with current position.
+static void print_ready() {
+  pos_phys_t current_pos = motion_get_current_pos();
+  comm_print("ready X%.3f Y%.3f Z%.3f", (double)current_pos.x,
+             (double)current_pos.y, (double)current_pos.z);
+}
+
+// Commands that neither move axes nor change their settings.
+// Position saved by homesave stays valid across these.
+static bool keeps_saved_home(const char* cmd) {
+  static const char* const cmds[] = {"help",     "stat",   "get",
+                                     "download", "homeok", "homesave"};
+  for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+    if (strcmp(cmd, cmds[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static void handle_console_command(char* command) {
   g_machine_state = STATE_EXEC_INTERACTIVE;
   comm_print_ack();
 
   // Check for G-code or M-code before destructive parsing
   if (command[0] == 'G' || command[0] == 'M') {
+    motion_discard_saved_home();
     cmd_gcode(command);  // Pass full command for G/M-code parsing
     goto cleanup;
   }
@@ -161,6 +242,9 @@ static void handle_console_command(char* command) {
   // Destructive parse: split command and arguments
   char* cmd = command;
   char* args = split_at(cmd, ' ');
+  if (!keeps_saved_home(cmd)) {
+    motion_discard_saved_home();
+  }
 
   // Dispatch to command handler
   if (strcmp(cmd, "help") == 0) {
@@ -169,6 +253,12 @@ static void handle_console_command(char* command) {
     cmd_stat(args);
   } else if (strcmp(cmd, "steptest") == 0) {
     cmd_steptest(args);
+  } else if (strcmp(cmd, "sgcal") == 0) {
+    cmd_sgcal(args);
+  } else if (strcmp(cmd, "homesave") == 0) {
+    cmd_homesave(args);
+  } else if (strcmp(cmd, "homeok") == 0) {
+    cmd_homeok(args);
   } else if (strcmp(cmd, "set") == 0) {
     cmd_set(args);
   } else if (strcmp(cmd, "get") == 0) {
@@ -184,17 +274,67 @@ cleanup:
   // Clear cancel flag and return to IDLE
   g_cancel_requested = false;
   g_machine_state = STATE_IDLE;
+  print_ready();
+}
 
-  // Print ready with current position
-  pos_phys_t current_pos = motion_get_current_pos();
-  comm_print("ready X%.3f Y%.3f Z%.3f", (double)current_pos.x,
-             (double)current_pos.y, (double)current_pos.z);
+// Next expected sequence number in EXEC_STREAM.
+static int stream_next_seq;
+
+// Finish running moves and return to IDLE.
+static void end_stream() {
+  comm_set_stream_seq(0);
+  gcode_wait_moves();
+  g_cancel_requested = false;
+  g_machine_state = STATE_IDLE;
+  print_ready();
+}
+
+// Handle stream line (":" seq " " command, or "::"). seq is -1 if malformed.
+static void handle_stream_command(int seq, char* command) {
+  if (g_machine_state == STATE_IDLE) {
+    if (seq != 1) {
+      comm_print_err("stream must start with :1");
+      return;
+    }
+    g_machine_state = STATE_EXEC_STREAM;
+    stream_next_seq = 1;
+    motion_discard_saved_home();
+  }
+
+  if (seq == 0) {
+    end_stream();
+    return;
+  }
+  if (seq != stream_next_seq) {
+    comm_print_err("wrong seq number");
+    end_stream();
+    return;
+  }
+  stream_next_seq++;
+
+  // Only G/M-codes can be streamed.
+  comm_set_stream_seq(seq);
+  comm_clear_err();
+  if (command[0] == 'G' || command[0] == 'M') {
+    cmd_gcode(command);
+  } else {
+    comm_print_err("not allowed in stream: %s", command);
+  }
+  comm_set_stream_seq(0);
+
+  // Errors or cancel terminate the stream.
+  if (comm_has_err() || g_cancel_requested) {
+    end_stream();
+    return;
+  }
+  comm_print_stream_rem(1);
 }
 
 int main() {
   // init core
   state_machine_init();
   comm_init();
+  nvstore_init();
 
   // init hardware
   motor_init();
@@ -208,6 +348,15 @@ int main() {
   settings_apply_all();
   comm_print("default settings applied");
 
+  // Offer position saved before reset
+  pos_phys_t saved_pos;
+  if (motion_load_home(&saved_pos)) {
+    comm_print(
+        "position before reset: X%.3f Y%.3f Z%.3f; 'homeok' to restore if "
+        "machine didn't move",
+        (double)saved_pos.x, (double)saved_pos.y, (double)saved_pos.z);
+  }
+
   // main command processing loop
   comm_print("Spark corefw: Type 'help' for commands");
 
@@ -217,7 +366,19 @@ int main() {
     comm_get_next_command(command);
 
     // Execute the command
-    handle_console_command(command);
+    int seq;
+    char* stream_command;
+    if (parse_stream_line(command, &seq, &stream_command)) {
+      handle_stream_command(seq, stream_command);
+    } else if (g_machine_state == STATE_EXEC_STREAM) {
+      // Cancelled ("") or interactive command during stream.
+      if (command[0] != '\0') {
+        comm_print_err("expected stream command: %s", command);
+      }
+      end_stream();
+    } else {
+      handle_console_command(command);
+    }
   }
 
   return 0;
@@ -4,73 +4,93 @@
 
 #include "comm.h"
 #include "motor.h"
+#include "nvstore.h"
 #include "pulser.h"
+#include "stallguard_base.h"
 #include "system.h"
 
 #include <drivers/tmc_driver.h>
 #include <math.h>
+#include <zephyr/drivers/counter.h>
+#include <zephyr/drivers/hwinfo.h>
 #include <zephyr/kernel.h>
 
+// Hardware devices
+static const struct device* motion_tick_cnt =
+    DEVICE_DT_GET(DT_NODELABEL(motion_tick_cnt));
+
 // Motion constants
-static const float VELOCITY_MM_PER_S = 10.0f;
+static const float MAX_JERK_MM_PER_S3 = 10000.0f;
+static const float TICK_PERIOD_S = 1.0f / CONFIG_MOTION_TICK_HZ;
+static const uint32_t TICK_PERIOD_US = 1000000 / CONFIG_MOTION_TICK_HZ;
 static const float EDM_INITIAL_VELOCITY_MM_PER_S = 0.5f;  // Start slow for EDM
-static const float TICK_PERIOD_S = 0.001f;  // 1ms tick period in seconds
 
-// Local position type for motion-controlled axes only
-typedef struct {
-  int m0, m1, m2;  // X, Y, Z axes in microsteps
-} pos_drv_t;
+// Motor driving each axis (X, Y, Z, A, B, C)
+static const int AXIS_MOTORS[AXIS_COUNT] = {0, 1, 2, 3, 4, 5};
+
+// Homeable axes (X, Y, Z) as bitmask
+#define ALL_HOME_AXES BIT_MASK(MOTION_HOME_AXIS_COUNT)
 
 // Motor configuration (pushed from settings)
 static float motor_unitsteps[MOTOR_COUNT] = {200.0f, 200.0f, 200.0f, 200.0f,
                                              200.0f, 200.0f, 200.0f};
 
+// Axis limits (pushed from settings)
+static pos_phys_t axis_max_vel = {30.0f, 30.0f, 30.0f, 1.0f, 1.0f, 1.0f};
+static pos_phys_t axis_max_acc = {300.0f, 300.0f, 300.0f, 10.0f, 10.0f, 10.0f};
+
 // Home configuration (pushed from settings)
-static float home_origins[3] = {0.0f, 0.0f, 0.0f};
-static float home_sides[3] = {1.0f, 1.0f, 1.0f};
+static float home_origins[MOTION_HOME_AXIS_COUNT] = {0.0f, 0.0f, 0.0f};
+static float home_sides[MOTION_HOME_AXIS_COUNT] = {1.0f, 1.0f, 1.0f};
+static int home_phases[MOTION_HOME_AXIS_COUNT] = {0, 0, 0};
+static float home_seek_vels[MOTION_HOME_AXIS_COUNT] = {10.0f, 10.0f, 10.0f};
+static float home_backoffs[MOTION_HOME_AXIS_COUNT] = {1.0f, 1.0f, 1.0f};
+static float home_touch_vels[MOTION_HOME_AXIS_COUNT] = {1.0f, 1.0f, 1.0f};
 
 // Homing offset: bridges gap between driver coords and physical coords
-// Updated after each successful home operation
-static pos_drv_t homing_offset = {0, 0, 0};
+// (microsteps of each axis). Updated after each successful home operation.
+static int homing_offset[AXIS_COUNT];
+// Axes whose position is known (homed, and no possible step loss since then)
+static int homed_axes = 0;
 
 // Constants
 static const float MAX_TRAVEL_MM = 500.0f;
 
-// Convert physical position to driver coordinates (microsteps)
-static pos_drv_t phys_to_drv(pos_phys_t phys) {
-  // Convert to raw driver steps
-  pos_drv_t raw_drv = {
-      .m0 = (int)(phys.x * motor_unitsteps[0]),   // X maps to motor 0
-      .m1 = (int)(phys.y * motor_unitsteps[1]),   // Y maps to motor 1
-      .m2 = (int)(phys.z * motor_unitsteps[2])};  // Z maps to motor 2
-
-  // Apply homing offset to align with current coordinate system
-  return (pos_drv_t){.m0 = raw_drv.m0 + homing_offset.m0,
-                     .m1 = raw_drv.m1 + homing_offset.m1,
-                     .m2 = raw_drv.m2 + homing_offset.m2};
+// StallGuard calibration: time per threshold, and margin of the result
+// (fraction of the threshold at which free running starts to stall).
+static const int SG_SAMPLE_MS = 10;
+static const float SG_CALIB_MARGIN = 0.8f;
+// Distance kept from home position when sweeping towards it (mm).
+static const float SG_SWEEP_CLEARANCE_MM = 1.0f;
+
+// Convert physical position to driver coordinates of each axis' motor
+// (microsteps, fractional)
+static void phys_to_drv(pos_phys_t phys, float drv[AXIS_COUNT]) {
+  // Convert to raw driver steps, and apply homing offset to align with current
+  // coordinate system
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    drv[axis] = posp_get(&phys, axis) * motor_unitsteps[AXIS_MOTORS[axis]] +
+                homing_offset[axis];
+  }
 }
 
-// Update homing offset after successful homing
-static void update_homing_offset(int axis) {
-  // Get current driver position (where we actually are)
-  pos_drv_t current_drv = {.m0 = motor_get_current_steps(0),
-                           .m1 = motor_get_current_steps(1),
-                           .m2 = motor_get_current_steps(2)};
-
-  // Calculate where driver coordinates should be for the new physical origin
-  pos_phys_t origin_phys = {home_origins[0], home_origins[1], home_origins[2]};
-  pos_drv_t raw_expected = {.m0 = (int)(origin_phys.x * motor_unitsteps[0]),
-                            .m1 = (int)(origin_phys.y * motor_unitsteps[1]),
-                            .m2 = (int)(origin_phys.z * motor_unitsteps[2])};
+// Set homing offset so that current driver position maps to phys_mm
+static void set_homing_offset(int axis, float phys_mm) {
+  int motor_num = AXIS_MOTORS[axis];
+  homing_offset[axis] = motor_get_current_steps(motor_num) -
+                        (int)lroundf(phys_mm * motor_unitsteps[motor_num]);
+}
 
-  // Update offset for the homed axis so current driver position maps to origin
-  if (axis == 0) {  // X axis
-    homing_offset.m0 = current_drv.m0 - raw_expected.m0;
-  } else if (axis == 1) {  // Y axis
-    homing_offset.m1 = current_drv.m1 - raw_expected.m1;
-  } else if (axis == 2) {  // Z axis
-    homing_offset.m2 = current_drv.m2 - raw_expected.m2;
+// Planning limits from axis limits, with velocity of each axis also capped by
+// max_vel.
+static plan_limits_t axis_limits(float max_vel, float junction_dev) {
+  plan_limits_t lim = {.max_acc = axis_max_acc,
+                       .max_jerk = MAX_JERK_MM_PER_S3,
+                       .junction_dev = junction_dev};
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    posp_set(&lim.max_vel, axis, fminf(posp_get(&axis_max_vel, axis), max_vel));
   }
+  return lim;
 }
 
 // Motion state
@@ -79,147 +99,334 @@ static motion_state_t state = MOTION_STATE_STOPPED;
 
 // Motion planning state
 static path_buffer_t motion_path;
+// Last point written to motion_path. Valid only while moving.
+static pos_phys_t path_end_pos;
+// Protects motion_path & motion state between tick handler and enqueue calls.
+static struct k_spinlock motion_lock;
+
+// Velocity profile of normal moves
+static vel_state_t vel_state;
+// Allowed deviation at corners of following paths. 0: exact stop.
+// Blending is opt-in (G64), as it also rounds corners of EDM paths.
+static float corner_tol = 0;
+// Path discretization of following paths (pushed from settings)
+static float edm_notch_mm = EDM_RESOLUTION_MM;
+static float edm_retract_mm = 1.0f;
+
+// EDM gap servo (config pushed from settings)
+static edm_servo_cfg_t edm_servo_cfg = {
+    .feedback = EDM_FEEDBACK_RATE,
+    .ign_ref_us = 50.0f,
+    .setpoint = 0.0f,
+    .kp = 2.0f,
+    .ki = 0.0f,
+    .kd = 0.0f,
+    .max_vel = 1.0f,
+    .max_retract_vel = 5.0f,
+    .max_acc = 1000.0f,
+    .readvance_vel = 10.0f,
+    .slow_zone_mm = 0.05f,
+};
+
+// Extremum-seeking tuning of servo setpoint (config pushed from settings)
+static edm_esc_cfg_t edm_esc_cfg = {
+    .enabled = false,
+    .amplitude = 0.05f,
+    .period_s = 0.5f,
+    .gain = 0.02f,
+    .min_base = -0.5f,
+    .max_base = 0.5f,
+};
 
 // EDM control state
 static bool is_edm_move = false;
-static float edm_current_speed = 0.0f;  // mm/s
+static edm_servo_t edm_servo;
+// Base is kept across moves, as the best setpoint depends on the machining
+// conditions rather than the move. Starts from edm_servo_cfg.setpoint (0).
+static edm_esc_t edm_esc;
+static float edm_last_gap;
+static uint32_t edm_last_polls;  // gap_est_t.polls of edm_last_gap
 
 // Stop condition flags
-static bool stop_at_stall;
 static bool stop_at_probe;
 static motion_stop_reason_t last_stop_reason;
-static int homing_axis;  // Which axis is being homed (-1 if not homing)
 
-// Timer for periodic tick
-static struct k_timer motion_timer;
+// Homing stages of an axis.
+// Fast seek finds the stall point roughly, and slow touch finds it precisely.
+typedef enum {
+  HOMING_SEEK,     // towards side at seek velocity, until stall
+  HOMING_BACKOFF,  // away from side by backoff distance
+  HOMING_TOUCH,    // towards side at touch velocity, until stall
+  HOMING_SWEEP,    // towards side at seek velocity, ignoring stall
+} homing_stage_t;
+
+// Homing state: each axis moves independently until its own stall.
+static int homing_axes;  // Bitmask of axes still seeking home (0: not homing)
+static bool homing_all_stalled;         // No axis finished without stall
+static homing_stage_t homing_stage[MOTION_HOME_AXIS_COUNT];
+static vel_state_t homing_vel[MOTION_HOME_AXIS_COUNT];
+static float homing_remaining_mm[MOTION_HOME_AXIS_COUNT];  // in current stage
+// Ramp-up of current stage is done. StallGuard is unreliable near standstill.
+static bool homing_at_speed[MOTION_HOME_AXIS_COUNT];
+
+// Move to next stage from standstill.
+static void start_homing_stage(int axis, homing_stage_t stage, float dist) {
+  homing_stage[axis] = stage;
+  homing_vel[axis] = (vel_state_t){0};
+  homing_remaining_mm[axis] = dist;
+  homing_at_speed[axis] = false;
+}
+
+// Move each homing axis by its stage, and finish it at stall of final stage.
+static void homing_tick_locked() {
+  for (int axis = 0; axis < MOTION_HOME_AXIS_COUNT; axis++) {
+    if (!(homing_axes & BIT(axis))) {
+      continue;
+    }
+    homing_stage_t stage = homing_stage[axis];
+
+    // Ignore stall while backing off (motor is still recovering from the
+    // seek stall), while sweeping threshold, and while ramping up.
+    bool towards_side = stage != HOMING_BACKOFF;
+    bool stops_at_stall = (stage == HOMING_SEEK || stage == HOMING_TOUCH) &&
+                          homing_at_speed[axis];
+    const struct device* motor = motor_get_device(AXIS_MOTORS[axis]);
+    if (stops_at_stall && motor && tmc_stalled(motor)) {
+      if (stage == HOMING_SEEK && home_backoffs[axis] > 0) {
+        start_homing_stage(axis, HOMING_BACKOFF, home_backoffs[axis]);
+        continue;
+      }
+
+      // Homing completed - stall detected
+      // Map current driver position to homing origin
+      set_homing_offset(axis, home_origins[axis]);
+      posp_set(&pos, axis, home_origins[axis]);
+      homing_axes &= ~BIT(axis);
+      homed_axes |= BIT(axis);
+      continue;
+    }
+
+    float vel = (stage == HOMING_TOUCH) ? home_touch_vels[axis]
+                                        : home_seek_vels[axis];
+    vel_limits_t lim = {
+        .max_vel = fminf(vel, posp_get(&axis_max_vel, axis)),
+        .max_acc = posp_get(&axis_max_acc, axis),
+        .max_jerk = MAX_JERK_MM_PER_S3};
+    float d = vel_step(&homing_vel[axis], &lim, homing_remaining_mm[axis], 0,
+                       TICK_PERIOD_S);
+    homing_remaining_mm[axis] -= d;
+    if (homing_vel[axis].vel > 0 && homing_vel[axis].acc <= 0) {
+      homing_at_speed[axis] = true;
+    }
+    float dir = towards_side ? home_sides[axis] : -home_sides[axis];
+    posp_set(&pos, axis, posp_get(&pos, axis) + dir * d);
+    if (homing_remaining_mm[axis] > 0) {
+      continue;
+    }
+
+    if (stage == HOMING_BACKOFF) {
+      // Touch should stall after ~backoff; allow twice of it.
+      start_homing_stage(axis, HOMING_TOUCH, 2 * home_backoffs[axis]);
+    } else {
+      // Traveled max distance without stall (or sweep completed)
+      homing_all_stalled = false;
+      homing_axes &= ~BIT(axis);
+    }
+  }
+}
 
-static void motion_tick_handler(struct k_timer* timer) {
+static void motion_tick_locked() {
   if (state != MOTION_STATE_MOVING) {
     return;
   }
 
   // Check for cancellation first (highest priority)
   if (g_cancel_requested) {
+    // Abrupt stop can lose steps.
+    homed_axes = 0;
+    homing_axes = 0;
     last_stop_reason = STOP_REASON_CANCELLED;
     state = MOTION_STATE_STOPPED;
     return;
   }
 
-  // Check for stall condition (homing)
-  if (stop_at_stall && homing_axis >= 0) {
-    const struct device* motor = motor_get_device(homing_axis);
-    if (motor && tmc_stalled(motor)) {
-      // Homing completed - stall detected
-      // Update homing offset before changing physical position
-      update_homing_offset(homing_axis);
-
-      // Set physical position to homing origin
-      pos.x = (homing_axis == 0) ? home_origins[0] : pos.x;
-      pos.y = (homing_axis == 1) ? home_origins[1] : pos.y;
-      pos.z = (homing_axis == 2) ? home_origins[2] : pos.z;
-
-      last_stop_reason = STOP_REASON_STALL_DETECTED;
+  // Move along path based on move type
+  if (homing_axes != 0) {
+    homing_tick_locked();
+    if (homing_axes == 0) {
+      last_stop_reason = homing_all_stalled ? STOP_REASON_STALL_DETECTED
+                                            : STOP_REASON_HOMING_FAILED;
       state = MOTION_STATE_STOPPED;
       return;
     }
-  }
-
-  // Move along path based on move type
-  if (is_edm_move) {
-    // EDM control logic
-    uint8_t open_rate = pulser_get_open_rate();
-    uint8_t short_rate = pulser_get_short_rate();
-
-    if (open_rate > 127) {
-      // too much open: too far away
-      pb_move(&motion_path, 1e-3f);  // +1 um / tick (-> 1mm/s max)
-    } else if (short_rate > 127) {
-      // too much short: too close
-      pb_move(&motion_path, -5e-3f);  // -5 um / tick (-> -5mm/s max)
+  } else if (is_edm_move) {
+    // Servo the gap: advance when open, retract when short.
+    edm_servo_cfg_t cfg = edm_servo_cfg;
+    if (edm_esc_cfg.enabled) {
+      cfg.setpoint = edm_esc_step(&edm_esc, &edm_esc_cfg,
+                                  pulser_get_pulse_count(), TICK_PERIOD_S);
+    }
+    gap_est_t gap_est = pulser_get_gap();
+    bool new_poll = gap_est.polls != edm_last_polls;
+    edm_last_polls = gap_est.polls;
+    edm_last_gap = edm_feedback_signal(&cfg, &gap_est);
+    float d = edm_servo_step(&edm_servo, &cfg, edm_last_gap, new_poll,
+                             TICK_PERIOD_S);
+    d = edm_servo_readvance(&edm_servo, &cfg, pb_get_retract(&motion_path), d,
+                            TICK_PERIOD_S);
+    if (!pb_move(&motion_path, d)) {
+      // Hit retraction limit: don't keep pushing against it.
+      edm_servo_init(&edm_servo, 0);
     }
   } else {
-    // Normal move
-    pb_move(&motion_path, VELOCITY_MM_PER_S * TICK_PERIOD_S);
+    // Normal move: follow velocity planned at each corner.
+    float v_brake;
+    float d_brake = pb_brake_target(&motion_path, &v_brake);
+    float d = vel_step(&vel_state, pb_seg_limits(&motion_path), d_brake,
+                       v_brake, TICK_PERIOD_S);
+    pb_move(&motion_path, d);
   }
-  pos = pb_get_pos(&motion_path);
+  if (homing_axes == 0) {
+    pos = pb_get_pos(&motion_path);
 
-  // Check if path completed
-  if (pb_at_end(&motion_path)) {
-    last_stop_reason = STOP_REASON_TARGET_REACHED;
-    state = MOTION_STATE_STOPPED;
-    return;
+    // Check if path completed (i.e. caught up with everything enqueued so far)
+    if (pb_at_tail(&motion_path)) {
+      last_stop_reason = STOP_REASON_TARGET_REACHED;
+      state = MOTION_STATE_STOPPED;
+      return;
+    }
   }
 
   // Convert to driver coordinates and send to motors
-  pos_drv_t target_drv = phys_to_drv(pos);
-  motor_set_target_steps(0, target_drv.m0);
-  motor_set_target_steps(1, target_drv.m1);
-  motor_set_target_steps(2, target_drv.m2);
+  float targets[AXIS_COUNT];
+  phys_to_drv(pos, targets);
+  motor_move_targets(AXIS_MOTORS, targets, AXIS_COUNT, TICK_PERIOD_US);
+}
+
+static void motion_tick_handler(const struct device* dev, void* user_data) {
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  motion_tick_locked();
+  k_spin_unlock(&motion_lock, key);
 }
 
 void motion_init() {
-  // Initialize timer for 1ms periodic tick
-  k_timer_init(&motion_timer, motion_tick_handler, NULL);
-  k_timer_start(&motion_timer, K_MSEC(1), K_MSEC(1));
+  // Initialize motion tick counter
+  struct counter_top_cfg tick_top_cfg = {
+      .callback = motion_tick_handler,
+      .ticks = counter_get_frequency(motion_tick_cnt) / CONFIG_MOTION_TICK_HZ,
+  };
+
+  counter_start(motion_tick_cnt);
+  int ret = counter_set_top_value(motion_tick_cnt, &tick_top_cfg);
+  if (ret < 0) {
+    comm_print_err("motion: tick timer init failed: %d", ret);
+    return;
+  }
 
-  comm_print("motion: init ok (1ms tick)");
+  comm_print("motion: init ok (%d Hz tick)", CONFIG_MOTION_TICK_HZ);
 }
 
 pos_phys_t motion_get_current_pos() {
   return pos;
 }
 
-void motion_enqueue_move(pos_phys_t to_pos) {
-  // Don't start new move if already moving
+pos_phys_t motion_get_end_pos() {
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  pos_phys_t end_pos = (state == MOTION_STATE_MOVING) ? path_end_pos : pos;
+  k_spin_unlock(&motion_lock, key);
+  return end_pos;
+}
+
+// Append to_pos to running path if possible, or start a new path if stopped.
+static bool enqueue_path_point_locked(const pos_phys_t* to_pos, bool edm) {
   if (state == MOTION_STATE_MOVING) {
-    return;
+    // Only same kind of moves can be joined.
+    if (homing_axes != 0 || is_edm_move != edm ||
+        !pb_can_write(&motion_path)) {
+      return false;
+    }
+    if (posp_dist(&path_end_pos, to_pos) < 0.001f) {
+      return true;  // zero-length segment would force a stop
+    }
+    pb_write(&motion_path, to_pos, false);
+    path_end_pos = *to_pos;
+    return true;
   }
 
   // Skip if no movement needed
-  float distance = posp_dist(&pos, &to_pos);
+  float distance = posp_dist(&pos, to_pos);
   if (distance < 0.001f) {
-    return;
+    return true;
   }
 
-  // Initialize path buffer with single segment
-  pb_init(&motion_path, &pos, &to_pos, true);  // Single segment, end=true
+  // Initialize path buffer with single segment, which can be extended later.
+  pb_init(&motion_path, &pos, to_pos, false);
+  pb_set_notch(&motion_path, edm_notch_mm, edm_retract_mm);
+  pb_set_blend_tol(&motion_path, corner_tol);
+  if (!edm) {
+    plan_limits_t lim = axis_limits(INFINITY, corner_tol);
+    pb_set_limits(&motion_path, &lim);
+  }
+  path_end_pos = *to_pos;
+
+  // Set move type
+  is_edm_move = edm;
+  vel_state = (vel_state_t){0};
+  if (edm) {
+    edm_servo_init(&edm_servo, EDM_INITIAL_VELOCITY_MM_PER_S);
+    edm_esc_init(&edm_esc, edm_esc.base, pulser_get_pulse_count());
+    edm_last_gap = 0;
+  }
 
-  // Clear stop conditions (normal move)
-  stop_at_stall = false;
+  // Clear stop conditions
   stop_at_probe = false;
-  homing_axis = -1;
-  is_edm_move = false;
+  homing_axes = 0;
 
   // Start moving
   state = MOTION_STATE_MOVING;
+  return true;
 }
 
-void motion_enqueue_edm_move(pos_phys_t to_pos) {
-  // Don't start new move if already moving
-  if (state == MOTION_STATE_MOVING) {
-    return;
-  }
+// Home position saved to flash, restorable only in the next boot.
+typedef struct {
+  uint32_t boot_count;  // boot in which it was saved
+  pos_phys_t pos;
+} home_record_t;
+
+static bool home_record_stored = false;  // flash has record of this boot
+static pos_phys_t home_record_pos;       // pos in the stored record
+static bool home_restorable = false;     // record of previous boot is loaded
+static pos_phys_t home_restore_pos;      // pos in the loaded record
+
+// Called before motion starts. Position will change, so loaded position is
+// not restorable after this. Flash is left untouched, as motors might be
+// moving; motion_discard_saved_home() must have been called before.
+static void forget_saved_home() {
+  home_restorable = false;
+}
 
-  // Skip if no movement needed
-  float distance = posp_dist(&pos, &to_pos);
-  if (distance < 0.001f) {
-    return;
+void motion_discard_saved_home() {
+  home_restorable = false;
+  if (home_record_stored && state != MOTION_STATE_MOVING) {
+    nvstore_delete(NVSTORE_ID_HOME);
+    home_record_stored = false;
   }
+}
 
-  // Initialize path buffer with single segment
-  pb_init(&motion_path, &pos, &to_pos, true);  // Single segment, end=true
-
-  // Set EDM mode
-  is_edm_move = true;
-  edm_current_speed = EDM_INITIAL_VELOCITY_MM_PER_S;
-
-  // Clear stop conditions
-  stop_at_stall = false;
-  stop_at_probe = false;
-  homing_axis = -1;
+bool motion_enqueue_move(pos_phys_t to_pos) {
+  forget_saved_home();
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  bool accepted = enqueue_path_point_locked(&to_pos, false);
+  k_spin_unlock(&motion_lock, key);
+  return accepted;
+}
 
-  // Start moving
-  state = MOTION_STATE_MOVING;
+bool motion_enqueue_edm_move(pos_phys_t to_pos) {
+  forget_saved_home();
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  bool accepted = enqueue_path_point_locked(&to_pos, true);
+  k_spin_unlock(&motion_lock, key);
+  return accepted;
 }
 
 motion_state_t motion_get_current_state() {
@@ -229,62 +436,323 @@ motion_state_t motion_get_current_state() {
 void motion_set_motor_unitsteps(int motor_num, float unitsteps) {
   if (motor_num >= 0 && motor_num < MOTOR_COUNT) {
     motor_unitsteps[motor_num] = unitsteps;
+    homed_axes = 0;  // physical position is not known anymore
+  }
+}
+
+void motion_set_corner_tol(float tol_mm) {
+  corner_tol = tol_mm;
+}
+
+void motion_set_edm_notch(float notch_mm) {
+  edm_notch_mm = notch_mm;
+}
+
+float motion_get_edm_notch() {
+  return edm_notch_mm;
+}
+
+void motion_set_edm_retract(float retract_mm) {
+  edm_retract_mm = retract_mm;
+}
+
+edm_servo_cfg_t motion_get_edm_servo() {
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  edm_servo_cfg_t cfg = edm_servo_cfg;
+  k_spin_unlock(&motion_lock, key);
+  return cfg;
+}
+
+void motion_set_edm_servo(const edm_servo_cfg_t* cfg) {
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  if (cfg->setpoint != edm_servo_cfg.setpoint) {
+    // Tuned base is relative to the old setpoint.
+    edm_esc_init(&edm_esc, cfg->setpoint, pulser_get_pulse_count());
   }
+  edm_servo_cfg = *cfg;
+  k_spin_unlock(&motion_lock, key);
+}
+
+edm_esc_cfg_t motion_get_edm_esc() {
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  edm_esc_cfg_t cfg = edm_esc_cfg;
+  k_spin_unlock(&motion_lock, key);
+  return cfg;
+}
+
+void motion_set_edm_esc(const edm_esc_cfg_t* cfg) {
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  if (cfg->enabled && !edm_esc_cfg.enabled) {
+    edm_esc_init(&edm_esc, edm_servo_cfg.setpoint, pulser_get_pulse_count());
+  }
+  edm_esc_cfg = *cfg;
+  k_spin_unlock(&motion_lock, key);
+}
+
+void motion_dump_status() {
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  motion_state_t st = state;
+  pos_phys_t p = pos;
+  bool edm = is_edm_move;
+  edm_servo_t servo = edm_servo;
+  edm_esc_t esc = edm_esc;
+  edm_esc_cfg_t esc_cfg = edm_esc_cfg;
+  float setpoint = edm_servo_cfg.setpoint;
+  float gap = edm_last_gap;
+  k_spin_unlock(&motion_lock, key);
+
+  comm_print("state: %s%s, homed: 0x%x",
+             st == MOTION_STATE_MOVING ? "moving" : "stopped",
+             edm ? " (EDM)" : "", homed_axes);
+  comm_print("pos: X%.3f Y%.3f Z%.3f A%.3f B%.3f C%.3f", (double)p.x,
+             (double)p.y, (double)p.z, (double)p.a, (double)p.b, (double)p.c);
+  if (!edm) {
+    return;
+  }
+  comm_print("servo: gap=%.3f vel=%.3fmm/s", (double)gap, (double)servo.vel);
+  if (esc_cfg.enabled) {
+    comm_print("esc: base=%.3f cycles=%d rate_high=%.0f/s rate_low=%.0f/s",
+               (double)esc.base, esc.cycles, (double)esc.rate_high,
+               (double)esc.rate_low);
+  } else {
+    comm_print("esc: off (setpoint=%.3f)", (double)setpoint);
+  }
+}
+
+void motion_set_axis_max_vel(int axis, float vel) {
+  posp_set(&axis_max_vel, axis, vel);
+}
+
+void motion_set_axis_max_acc(int axis, float acc) {
+  posp_set(&axis_max_acc, axis, acc);
 }
 
 void motion_set_home_origin(int axis, float origin_mm) {
-  if (axis >= 0 && axis < 3) {
+  if (axis >= 0 && axis < MOTION_HOME_AXIS_COUNT) {
     home_origins[axis] = origin_mm;
   }
 }
 
 void motion_set_home_side(int axis, float side) {
-  if (axis >= 0 && axis < 3) {
+  if (axis >= 0 && axis < MOTION_HOME_AXIS_COUNT) {
     home_sides[axis] = side;
   }
 }
 
+void motion_set_home_phase(int axis, int phase) {
+  if (axis >= 0 && axis < MOTION_HOME_AXIS_COUNT) {
+    home_phases[axis] = phase;
+  }
+}
+
+int motion_get_home_phase(int axis) {
+  return (axis >= 0 && axis < MOTION_HOME_AXIS_COUNT) ? home_phases[axis]
+                                                      : -1;
+}
+
+void motion_set_home_seek_vel(int axis, float vel) {
+  if (axis >= 0 && axis < MOTION_HOME_AXIS_COUNT) {
+    home_seek_vels[axis] = vel;
+  }
+}
+
+void motion_set_home_backoff(int axis, float backoff_mm) {
+  if (axis >= 0 && axis < MOTION_HOME_AXIS_COUNT) {
+    home_backoffs[axis] = backoff_mm;
+  }
+}
+
+void motion_set_home_touch_vel(int axis, float vel) {
+  if (axis >= 0 && axis < MOTION_HOME_AXIS_COUNT) {
+    home_touch_vels[axis] = vel;
+  }
+}
+
 motion_stop_reason_t motion_get_last_stop_reason() {
   return last_stop_reason;
 }
 
-void motion_enqueue_home(int axis) {
+bool motion_enqueue_home(int axes) {
+  // Validate axes
+  axes &= ALL_HOME_AXES;
+  if (axes == 0) {
+    return true;
+  }
+  forget_saved_home();
+
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
   // Don't start new move if already moving
   if (state == MOTION_STATE_MOVING) {
-    return;
+    k_spin_unlock(&motion_lock, key);
+    return false;
   }
 
-  // Validate axis
-  if (axis < 0 || axis >= 3) {
-    return;
+  // Set stop conditions for homing: each axis seeks up to MAX_TRAVEL_MM
+  for (int axis = 0; axis < MOTION_HOME_AXIS_COUNT; axis++) {
+    start_homing_stage(axis, HOMING_SEEK, MAX_TRAVEL_MM);
   }
+  homing_axes = axes;
+  homed_axes &= ~axes;
+  homing_all_stalled = true;
+  stop_at_probe = false;
+  is_edm_move = false;
+  path_end_pos = pos;
 
-  // Calculate target position for homing
-  pos_phys_t home_target = pos;
-  float side = home_sides[axis];
-  if (axis == 0) {
-    home_target.x += side * MAX_TRAVEL_MM;
-  } else if (axis == 1) {
-    home_target.y += side * MAX_TRAVEL_MM;
-  } else if (axis == 2) {
-    home_target.z += side * MAX_TRAVEL_MM;
-  }
+  // Start homing
+  state = MOTION_STATE_MOVING;
+  k_spin_unlock(&motion_lock, key);
+  return true;
+}
 
-  // Skip if no movement needed
-  float distance = posp_dist(&pos, &home_target);
-  if (distance < 0.001f) {
-    return;
+int motion_calibrate_stallguard(int axis) {
+  if (axis < 0 || axis >= MOTION_HOME_AXIS_COUNT) {
+    return -EINVAL;
+  }
+  const struct device* motor = motor_get_device(AXIS_MOTORS[axis]);
+  if (!motor) {
+    return -EINVAL;
   }
+  forget_saved_home();
 
-  // Initialize path buffer with single segment
-  pb_init(&motion_path, &pos, &home_target, true);  // Single segment, end=true
+  // Run freely towards home side at seek velocity, long enough to finish
+  // the sweep after acceleration. Sampling can be delayed; allow 20% more.
+  float vel = fminf(home_seek_vels[axis], posp_get(&axis_max_vel, axis));
+  float acc = posp_get(&axis_max_acc, axis);
+  float ramp_s = vel / acc + acc / MAX_JERK_MM_PER_S3;
+  float sweep_s = SG_SWEEP_MAX_SAMPLES * SG_SAMPLE_MS / 1000.0f;
+  float dist = vel * (2 * ramp_s + 1.2f * sweep_s);
 
-  // Set stop conditions for homing
-  stop_at_stall = true;
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  if (state == MOTION_STATE_MOVING) {
+    k_spin_unlock(&motion_lock, key);
+    return -EBUSY;
+  }
+  // Only the range between home and current position is known to be clear.
+  if (!(homed_axes & BIT(axis))) {
+    k_spin_unlock(&motion_lock, key);
+    comm_print("sgcal: axis not homed; home it with the current threshold");
+    return -EACCES;
+  }
+  float clear_mm =
+      (home_origins[axis] - posp_get(&pos, axis)) * home_sides[axis] -
+      SG_SWEEP_CLEARANCE_MM;
+  if (clear_mm < dist) {
+    k_spin_unlock(&motion_lock, key);
+    comm_print("sgcal: needs %.1fmm of travel; move %.1fmm further from home",
+               (double)(dist + SG_SWEEP_CLEARANCE_MM),
+               (double)(dist - clear_mm));
+    return -ERANGE;
+  }
+  start_homing_stage(axis, HOMING_SWEEP, dist);
+  homing_axes = BIT(axis);
+  homing_all_stalled = true;
   stop_at_probe = false;
-  homing_axis = axis;
   is_edm_move = false;
-
-  // Start homing
+  path_end_pos = pos;
   state = MOTION_STATE_MOVING;
+  k_spin_unlock(&motion_lock, key);
+
+  // Sweep threshold at constant velocity.
+  k_sleep(K_MSEC((int)(ramp_s * 1000) + SG_SAMPLE_MS));
+  sg_sweep_t sw;
+  sg_sweep_init(&sw);
+  bool swept = false;
+  while (state == MOTION_STATE_MOVING) {
+    tmc_set_stallguard_threshold(motor, sw.thresh);
+    k_sleep(K_MSEC(SG_SAMPLE_MS));
+    if (state != MOTION_STATE_MOVING) {
+      break;
+    }
+    if (!sg_sweep_update(&sw, tmc_sgresult(motor), tmc_stalled(motor))) {
+      swept = true;
+      break;
+    }
+  }
+
+  // Let the axis stop.
+  while (state == MOTION_STATE_MOVING) {
+    k_sleep(K_MSEC(SG_SAMPLE_MS));
+  }
+  if (last_stop_reason == STOP_REASON_CANCELLED) {
+    return -ECANCELED;
+  }
+  if (!swept) {
+    comm_print("sgcal: ran out of travel before sweep completed");
+    return -ERANGE;
+  }
+
+  comm_print("sgcal: min SG_RESULT %d, clean threshold %d", sw.sg_min,
+             sw.clean_thresh);
+  int thresh = sg_sweep_result(&sw, SG_CALIB_MARGIN);
+  return (thresh < 0) ? -EIO : thresh;
+}
+
+bool motion_save_home() {
+  if (state == MOTION_STATE_MOVING) {
+    return false;
+  }
+
+  // Position survives reset only if it's known, and motors keep holding it.
+  bool trusted = homed_axes == ALL_HOME_AXES;
+  for (int axis = 0; axis < MOTION_HOME_AXIS_COUNT; axis++) {
+    trusted = trusted && motor_is_held(AXIS_MOTORS[axis]);
+  }
+  if (!trusted) {
+    motion_discard_saved_home();
+    return false;
+  }
+
+  if (home_record_stored && posp_dist(&home_record_pos, &pos) == 0) {
+    return true;  // already saved
+  }
+  home_record_t rec = {.boot_count = nvstore_get_boot_count(), .pos = pos};
+  if (nvstore_write(NVSTORE_ID_HOME, &rec, sizeof(rec)) != 0) {
+    return false;
+  }
+  home_record_stored = true;
+  home_record_pos = pos;
+  return true;
+}
+
+bool motion_load_home(pos_phys_t* saved_pos) {
+  // Reset flags are sticky; clear them to see only this reset next time.
+  uint32_t reset_cause = 0;
+  hwinfo_get_reset_cause(&reset_cause);
+  hwinfo_clear_reset_cause();
+
+  home_record_t rec;
+  if (nvstore_read(NVSTORE_ID_HOME, &rec, sizeof(rec)) < 0) {
+    return false;
+  }
+  // Older records might be from before manual moves.
+  if (rec.boot_count + 1 != nvstore_get_boot_count()) {
+    return false;
+  }
+  // Motors don't hold position through power loss.
+  if (reset_cause & (RESET_POR | RESET_BROWNOUT)) {
+    return false;
+  }
+
+  home_restorable = true;
+  home_restore_pos = rec.pos;
+  *saved_pos = rec.pos;
+  return true;
+}
+
+bool motion_restore_home() {
+  k_spinlock_key_t key = k_spin_lock(&motion_lock);
+  if (!home_restorable || state == MOTION_STATE_MOVING) {
+    k_spin_unlock(&motion_lock, key);
+    return false;
+  }
+
+  // Map current driver position to the saved physical position.
+  pos = home_restore_pos;
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    set_homing_offset(axis, posp_get(&pos, axis));
+  }
+  homed_axes = ALL_HOME_AXES;
+  home_restorable = false;
+  k_spin_unlock(&motion_lock, key);
+  return true;
 }
@@ -5,6 +5,7 @@
  */
 #pragma once
 
+#include "edm_base.h"
 #include "motion_base.h"
 
 /**
@@ -22,7 +23,8 @@ typedef enum {
   STOP_REASON_TARGET_REACHED,
   STOP_REASON_PROBE_TRIGGERED,
   STOP_REASON_STALL_DETECTED,
-  STOP_REASON_CANCELLED,  // Stopped due to cancel request
+  STOP_REASON_HOMING_FAILED,  // Some axis didn't stall within max travel
+  STOP_REASON_CANCELLED,      // Stopped due to cancel request
 } motion_stop_reason_t;
 
 /**
@@ -31,12 +33,43 @@ typedef enum {
 void motion_init();
 
 pos_phys_t motion_get_current_pos();
-void motion_enqueue_move(pos_phys_t to_pos);
-void motion_enqueue_edm_move(pos_phys_t to_pos);
-void motion_enqueue_home(int axis);
+
+/** Get position where all enqueued motion will end.
+ * Same as motion_get_current_pos() when stopped.
+ */
+pos_phys_t motion_get_end_pos();
+
+/**
+ * Enqueue motion commands.
+ *
+ * Moves of the same kind (normal or EDM) are appended to the running path
+ * without stopping, as long as the path buffer has room. Otherwise, new motion
+ * starts only after current motion is stopped.
+ *
+ * @return true if accepted (including no-op). false if motion is busy; caller
+ * should retry later.
+ */
+bool motion_enqueue_move(pos_phys_t to_pos);
+bool motion_enqueue_edm_move(pos_phys_t to_pos);
+/** Home axes in the bitmask (BIT(0): X, BIT(1): Y, BIT(2): Z) together.
+ * Each axis stops independently when its own motor stalls.
+ * Stop reason is STOP_REASON_STALL_DETECTED if all axes stalled, otherwise
+ * STOP_REASON_HOMING_FAILED.
+ * @return false if motion is busy.
+ */
+bool motion_enqueue_home(int axes);
 motion_state_t motion_get_current_state();
 motion_stop_reason_t motion_get_last_stop_reason();
 
+// Allowed deviation from the path at corners (mm), when G64 has no P.
+#define MOTION_DEFAULT_CORNER_TOL_MM 0.01f
+
+/** Set allowed deviation from the path at corners (mm), for paths started
+ * after this call. Corners are blended within the tolerance, and passed
+ * without stopping. 0 (startup default) means exact stop at every corner.
+ */
+void motion_set_corner_tol(float tol_mm);
+
 /** Set how many microsteps are needed for moving the corresponding axis in
  * +1unit (+1 mm or +1 rotation).
  *
@@ -44,6 +77,95 @@ motion_stop_reason_t motion_get_last_stop_reason();
  */
 void motion_set_motor_unitsteps(int motor_num, float unitsteps);
 
+/** Set EDM notch (positional resolution along path) and max retraction
+ * distance, in mm. Applied to paths started after this call.
+ */
+void motion_set_edm_notch(float notch_mm);
+void motion_set_edm_retract(float retract_mm);
+float motion_get_edm_notch();
+
+/** Get / set EDM gap servo config. Applied immediately, even during a move. */
+edm_servo_cfg_t motion_get_edm_servo();
+void motion_set_edm_servo(const edm_servo_cfg_t* cfg);
+
+/** Get / set extremum-seeking tuning of servo setpoint. Base setpoint is kept
+ * across EDM paths, and reset to the servo setpoint when tuning is enabled or
+ * the servo setpoint changes.
+ */
+edm_esc_cfg_t motion_get_edm_esc();
+void motion_set_edm_esc(const edm_esc_cfg_t* cfg);
+
+/** (blocking) Dump motion status (incl. EDM servo) for debugging. */
+void motion_dump_status();
+
+/** Set velocity (mm/s) and acceleration (mm/s^2) limits of an axis
+ * (0 ~ AXIS_COUNT - 1). Rotary axes use rotations instead of mm.
+ * Each move runs at the fastest speed allowed by all of its axes.
+ * Applied to paths started after this call.
+ */
+void motion_set_axis_max_vel(int axis, float vel);
+void motion_set_axis_max_acc(int axis, float acc);
+
+// Axes that can be homed: X, Y, Z (axis 0 ~ 2).
+#define MOTION_HOME_AXIS_COUNT 3
+
 /** Called by settings system when home settings change */
 void motion_set_home_origin(int axis, float origin_mm);
 void motion_set_home_side(int axis, float side);
+
+// Max value of home phase.
+#define MOTION_MAX_HOME_PHASE 9
+
+/** Set home phase of an axis (0~MOTION_MAX_HOME_PHASE). G28 without axis homes
+ * axes phase by phase in ascending order; axes of the same phase move
+ * simultaneously.
+ */
+void motion_set_home_phase(int axis, int phase);
+int motion_get_home_phase(int axis);
+
+/** Set two-stage homing of an axis: seek towards side at seek velocity (mm/s)
+ * until stall, back off by backoff (mm), then touch again at touch velocity
+ * (mm/s) until stall. Only the touch sets home position.
+ * backoff = 0 skips the touch; seek stall sets home position.
+ */
+void motion_set_home_seek_vel(int axis, float vel);
+void motion_set_home_backoff(int axis, float backoff_mm);
+void motion_set_home_touch_vel(int axis, float vel);
+
+/** (blocking) Find StallGuard threshold of an axis for homing at its seek
+ * velocity. The axis runs freely towards its home side (about seek velocity
+ * x 1 sec), while threshold is swept. The axis must be homed, and far enough
+ * from home for the run. Threshold of the motor is left modified; caller
+ * should apply the result (or restore the old value).
+ *
+ * @return threshold (0~255), or negative error code: -EACCES if not homed,
+ * -ERANGE if travel is not enough.
+ */
+int motion_calibrate_stallguard(int axis);
+
+/** (blocking) Save current position to flash, if it will still be valid after
+ * reset: all axes are homed, and their motors are held energized
+ * (m.N.idlems < 0). Otherwise, delete position saved in this boot.
+ * Fails while moving; flash write stalls the CPU.
+ * @return true if saved.
+ */
+bool motion_save_home();
+
+/** (blocking) Delete position saved by motion_save_home(), and forget loaded
+ * one. Call before anything that can move axes or change their scale.
+ * Flash is only written if there's a saved position, and not while moving.
+ */
+void motion_discard_saved_home();
+
+/** Load position saved in the previous boot, unless reset was by power loss.
+ * Once loaded, it can be restored by motion_restore_home() until motion
+ * starts.
+ * @return true if there's a restorable position.
+ */
+bool motion_load_home(pos_phys_t* saved_pos);
+
+/** Set current position to the loaded one, and treat all axes as homed.
+ * Caller must confirm that the machine didn't move since the save.
+ * @return false if nothing is restorable.
+ */
+bool motion_restore_home();
@@ -2,23 +2,527 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 #include "motion_base.h"
 
+#include <limits.h>
 #include <math.h>
 #include <string.h>
 
+// M_PI is not in ISO C.
+static const float PI = 3.14159265f;
+
+static inline int32_t mm_to_subnotches(const path_buffer_t* pb, float d) {
+  return lroundf(d * (PB_SUBNOTCHES / pb->notch_mm));
+}
+
+static inline float subnotches_to_mm(const path_buffer_t* pb, int32_t d) {
+  return d * (pb->notch_mm / PB_SUBNOTCHES);
+}
+
+float posp_get(const pos_phys_t* p, int axis) {
+  switch (axis) {
+    case 0:
+      return p->x;
+    case 1:
+      return p->y;
+    case 2:
+      return p->z;
+    case 3:
+      return p->a;
+    case 4:
+      return p->b;
+    case 5:
+      return p->c;
+    default:
+      return 0;
+  }
+}
+
+void posp_set(pos_phys_t* p, int axis, float value) {
+  switch (axis) {
+    case 0:
+      p->x = value;
+      break;
+    case 1:
+      p->y = value;
+      break;
+    case 2:
+      p->z = value;
+      break;
+    case 3:
+      p->a = value;
+      break;
+    case 4:
+      p->b = value;
+      break;
+    case 5:
+      p->c = value;
+      break;
+  }
+}
+
+// a - b
+static pos_phys_t posp_sub(const pos_phys_t* a, const pos_phys_t* b) {
+  pos_phys_t out;
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    posp_set(&out, i, posp_get(a, i) - posp_get(b, i));
+  }
+  return out;
+}
+
+// p + k * d
+static pos_phys_t posp_add_scaled(const pos_phys_t* p,
+                                  float k,
+                                  const pos_phys_t* d) {
+  pos_phys_t out;
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    posp_set(&out, i, posp_get(p, i) + k * posp_get(d, i));
+  }
+  return out;
+}
+
+// k * p
+static pos_phys_t posp_scale(const pos_phys_t* p, float k) {
+  pos_phys_t out;
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    posp_set(&out, i, k * posp_get(p, i));
+  }
+  return out;
+}
+
+static float posp_dot(const pos_phys_t* a, const pos_phys_t* b) {
+  float sum = 0;
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    sum += posp_get(a, i) * posp_get(b, i);
+  }
+  return sum;
+}
+
+// Unit vector from a to b, given their distance len (> 0).
+static pos_phys_t posp_unit(const pos_phys_t* a,
+                            const pos_phys_t* b,
+                            float len) {
+  pos_phys_t d = posp_sub(b, a);
+  return posp_scale(&d, 1 / len);
+}
+
 float posp_dist(const pos_phys_t* a, const pos_phys_t* b) {
-  float dx = b->x - a->x;
-  float dy = b->y - a->y;
-  float dz = b->z - a->z;
-  return sqrtf(dx * dx + dy * dy + dz * dz);
+  pos_phys_t d = posp_sub(b, a);
+  return sqrtf(posp_dot(&d, &d));
 }
 
 void posp_interp(const pos_phys_t* a,
                  const pos_phys_t* b,
                  float t,
                  pos_phys_t* out) {
-  out->x = a->x + (b->x - a->x) * t;
-  out->y = a->y + (b->y - a->y) * t;
-  out->z = a->z + (b->z - a->z) * t;
+  pos_phys_t d = posp_sub(b, a);
+  *out = posp_add_scaled(a, t, &d);
+}
+
+// Convert between pos_phys_t and (u, v, w) coordinates of the plane.
+static void to_plane(arc_plane_t plane,
+                     const pos_phys_t* p,
+                     float* u,
+                     float* v,
+                     float* w) {
+  switch (plane) {
+    case ARC_PLANE_ZX:
+      *u = p->z;
+      *v = p->x;
+      *w = p->y;
+      break;
+    case ARC_PLANE_YZ:
+      *u = p->y;
+      *v = p->z;
+      *w = p->x;
+      break;
+    default:
+      *u = p->x;
+      *v = p->y;
+      *w = p->z;
+      break;
+  }
+}
+
+// Set X, Y, Z of p from (u, v, w). Other axes are kept.
+static void set_plane(arc_plane_t plane,
+                      float u,
+                      float v,
+                      float w,
+                      pos_phys_t* p) {
+  switch (plane) {
+    case ARC_PLANE_ZX:
+      p->x = v;
+      p->y = w;
+      p->z = u;
+      break;
+    case ARC_PLANE_YZ:
+      p->x = w;
+      p->y = u;
+      p->z = v;
+      break;
+    default:
+      p->x = u;
+      p->y = v;
+      p->z = w;
+      break;
+  }
+}
+
+bool arc_center_from_radius(const pos_phys_t* start,
+                            const pos_phys_t* end,
+                            float radius,
+                            bool cw,
+                            arc_plane_t plane,
+                            pos_phys_t* center) {
+  float u0, v0, w0, u1, v1, w1;
+  to_plane(plane, start, &u0, &v0, &w0);
+  to_plane(plane, end, &u1, &v1, &w1);
+  float du = u1 - u0;
+  float dv = v1 - v0;
+  float d = sqrtf(du * du + dv * dv);
+  if (d < 1e-6f || d > 2 * fabsf(radius) * (1 + 1e-4f)) {
+    return false;
+  }
+
+  // Center is on the perpendicular bisector, h away from the midpoint.
+  // For CCW & short arc, center is on the left side of start -> end.
+  float h2 = radius * radius - 0.25f * d * d;
+  float h = (h2 > 0) ? sqrtf(h2) : 0;
+  if (cw != (radius < 0)) {
+    h = -h;
+  }
+  float cu = 0.5f * (u0 + u1) - h * dv / d;
+  float cv = 0.5f * (v0 + v1) + h * du / d;
+  *center = *start;
+  set_plane(plane, cu, cv, w0, center);
+  return true;
+}
+
+bool arc_init(arc_iter_t* it,
+              const pos_phys_t* start,
+              const pos_phys_t* end,
+              const pos_phys_t* center,
+              bool cw,
+              arc_plane_t plane,
+              float chord_tol) {
+  float u0, v0, u1, v1, center_w;
+  *it = (arc_iter_t){0};
+  it->plane = plane;
+  it->start = *start;
+  it->end = *end;
+  to_plane(plane, start, &u0, &v0, &it->w_start);
+  to_plane(plane, end, &u1, &v1, &it->w_end);
+  to_plane(plane, center, &it->center_u, &it->center_v, &center_w);
+
+  it->radius_start = hypotf(u0 - it->center_u, v0 - it->center_v);
+  it->radius_end = hypotf(u1 - it->center_u, v1 - it->center_v);
+  if (it->radius_start < 1e-6f ||
+      fabsf(it->radius_end - it->radius_start) >
+          fmaxf(0.005f, 0.001f * it->radius_start)) {
+    return false;
+  }
+
+  it->angle_start = atan2f(v0 - it->center_v, u0 - it->center_u);
+  float angle_end = atan2f(v1 - it->center_v, u1 - it->center_u);
+  float sweep = angle_end - it->angle_start;
+  bool full_circle = hypotf(u1 - u0, v1 - v0) < 1e-6f;
+  if (cw) {
+    if (sweep >= 0 || full_circle) {
+      sweep -= 2 * PI;
+    }
+  } else {
+    if (sweep <= 0 || full_circle) {
+      sweep += 2 * PI;
+    }
+  }
+  it->sweep = sweep;
+
+  // Chord of angle a deviates r * (1 - cos(a/2)) from the arc.
+  float r = fmaxf(it->radius_start, it->radius_end);
+  float cos_half = 1 - chord_tol / r;
+  float max_angle = (cos_half > 0.7071f) ? 2 * acosf(cos_half)
+                                          : 0.5f * PI;
+  it->num_chords = (int)ceilf(fabsf(sweep) / max_angle);
+  if (it->num_chords < 1) {
+    it->num_chords = 1;
+  }
+  return true;
+}
+
+bool arc_next(arc_iter_t* it, pos_phys_t* out) {
+  if (it->ix_chord >= it->num_chords) {
+    return false;
+  }
+  it->ix_chord++;
+  if (it->ix_chord == it->num_chords) {
+    *out = it->end;
+    return true;
+  }
+  float t = (float)it->ix_chord / it->num_chords;
+  float angle = it->angle_start + it->sweep * t;
+  float r = it->radius_start + (it->radius_end - it->radius_start) * t;
+  posp_interp(&it->start, &it->end, t, out);
+  set_plane(it->plane, it->center_u + r * cosf(angle),
+            it->center_v + r * sinf(angle),
+            it->w_start + (it->w_end - it->w_start) * t, out);
+  return true;
+}
+
+void bezier_init(bezier_iter_t* it,
+                 const pos_phys_t* start,
+                 const pos_phys_t* ctrl1,
+                 const pos_phys_t* ctrl2,
+                 const pos_phys_t* end,
+                 float tol) {
+  it->p[0] = *start;
+  it->p[1] = *ctrl1;
+  it->p[2] = *ctrl2;
+  it->p[3] = *end;
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    posp_set(&it->d2_start, i,
+             posp_get(start, i) - 2 * posp_get(ctrl1, i) + posp_get(ctrl2, i));
+    posp_set(&it->d2_end, i,
+             posp_get(ctrl1, i) - 2 * posp_get(ctrl2, i) + posp_get(end, i));
+  }
+  it->tol = tol;
+  it->t = 0;
+}
+
+// |second derivative| of the curve at t.
+static float bezier_d2_norm(const bezier_iter_t* it, float t) {
+  pos_phys_t d2;
+  posp_interp(&it->d2_start, &it->d2_end, t, &d2);
+  return 6 * sqrtf(posp_dot(&d2, &d2));
+}
+
+bool bezier_next(bezier_iter_t* it, pos_phys_t* out) {
+  const float MIN_DT = 1.0f / 4096;
+  float t = it->t;
+  if (t >= 1) {
+    return false;
+  }
+
+  // Chord over [t, t + dt] deviates at most dt^2 / 8 * max|B''| from the
+  // curve. |B''| is max at either end, as B'' is linear in t.
+  float d2 = bezier_d2_norm(it, t);
+  float dt = (d2 > 0) ? sqrtf(8 * it->tol / d2) : 1;
+  dt = fminf(dt, 1 - t);
+  while (dt > MIN_DT) {
+    float d2_max = fmaxf(d2, bezier_d2_norm(it, t + dt));
+    if (dt * dt * d2_max <= 8 * it->tol) {
+      break;
+    }
+    dt *= 0.5f;
+  }
+  t += fmaxf(dt, MIN_DT);
+
+  if (t >= 1 - 1e-6f) {
+    it->t = 1;
+    *out = it->p[3];
+    return true;
+  }
+  it->t = t;
+  float s = 1 - t;
+  float w0 = s * s * s;
+  float w1 = 3 * s * s * t;
+  float w2 = 3 * s * t * t;
+  float w3 = t * t * t;
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    posp_set(out, i,
+             w0 * posp_get(&it->p[0], i) + w1 * posp_get(&it->p[1], i) +
+                 w2 * posp_get(&it->p[2], i) + w3 * posp_get(&it->p[3], i));
+  }
+  return true;
+}
+
+float vel_ramp_dist(const vel_limits_t* lim, float v0, float v1) {
+  float dv = fabsf(v1 - v0);
+  float a = lim->max_acc;
+  float j = lim->max_jerk;
+
+  // Ramp is symmetric, thus average velocity is always (v0 + v1) / 2.
+  float t;
+  if (j <= 0) {
+    t = dv / a;
+  } else if (dv >= a * a / j) {
+    // reaches max_acc: jerk - constant acc - jerk
+    t = dv / a + a / j;
+  } else {
+    // triangular acceleration
+    t = 2 * sqrtf(dv / j);
+  }
+  return 0.5f * (v0 + v1) * t;
+}
+
+float vel_reachable(const vel_limits_t* lim, float v_end, float d) {
+  if (v_end >= lim->max_vel ||
+      vel_ramp_dist(lim, lim->max_vel, v_end) <= d) {
+    return lim->max_vel;
+  }
+
+  if (lim->max_jerk <= 0) {
+    return sqrtf(v_end * v_end + 2 * lim->max_acc * d);
+  }
+
+  // vel_ramp_dist is monotonic in v; bisect.
+  float v_lo = v_end;
+  float v_hi = lim->max_vel;
+  for (int i = 0; i < 20; i++) {
+    float v_mid = 0.5f * (v_lo + v_hi);
+    if (vel_ramp_dist(lim, v_mid, v_end) <= d) {
+      v_lo = v_mid;
+    } else {
+      v_hi = v_mid;
+    }
+  }
+  return v_lo;
+}
+
+float vel_step(vel_state_t* st,
+               const vel_limits_t* lim,
+               float d_remaining,
+               float v_end,
+               float dt) {
+  if (d_remaining <= 0) {
+    st->vel = 0;
+    st->acc = 0;
+    return 0;
+  }
+  float v = st->vel;
+
+  // Acceleration to use if speeding up.
+  float acc;
+  if (lim->max_jerk <= 0) {
+    acc = lim->max_acc;
+  } else {
+    float d_acc = lim->max_jerk * dt;
+    float curr_acc = (st->acc > 0) ? st->acc : 0;
+    if (v + curr_acc * curr_acc / (2 * lim->max_jerk) >= lim->max_vel) {
+      // Reduce acceleration early, not to overshoot max_vel.
+      acc = (curr_acc > d_acc) ? curr_acc - d_acc : 0;
+    } else {
+      acc = (curr_acc + d_acc < lim->max_acc) ? curr_acc + d_acc
+                                                : lim->max_acc;
+    }
+  }
+  float v_new = fminf(v + acc * dt, lim->max_vel);
+  // Slow down when over max_vel (e.g. limit changed).
+  v_new = fmaxf(v_new, v - lim->max_acc * dt);
+
+  // Velocity that still allows slowing down to v_end after this tick.
+  // Stopping is prioritized over acc & jerk limits.
+  // Minimum velocity is kept, not to asymptotically approach the end forever.
+  float d_after = fmaxf(d_remaining - v * dt, 0);
+  float v_cap = fmaxf(vel_reachable(lim, v_end, d_after),
+                      fminf(lim->max_acc * dt, lim->max_vel));
+  v_new = fminf(v_new, v_cap);
+
+  float d = 0.5f * (v + v_new) * dt;
+  if (d >= d_remaining) {
+    // Arrived. Stop exactly at the end, or pass through it at v_end.
+    v_new = fminf(v_new, v_end);
+    if (v_end <= 0) {
+      d = d_remaining;
+    }
+  }
+  st->acc = (v_new - v) / dt;
+  st->vel = v_new;
+  return d;
+}
+
+float posp_limit_along(const pos_phys_t* dir, const pos_phys_t* limits) {
+  float limit = INFINITY;
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    float c = fabsf(posp_get(dir, i));
+    if (c > 1e-6f) {
+      limit = fminf(limit, posp_get(limits, i) / c);
+    }
+  }
+  return limit;
+}
+
+float posp_junction_vel(const pos_phys_t* a,
+                        const pos_phys_t* b,
+                        const pos_phys_t* c,
+                        const plan_limits_t* lim) {
+  float len_ab = posp_dist(a, b);
+  float len_bc = posp_dist(b, c);
+  if (len_ab < 1e-6f || len_bc < 1e-6f) {
+    return 0;
+  }
+
+  // unit directions
+  pos_phys_t u_ab = posp_unit(a, b, len_ab);
+  pos_phys_t u_bc = posp_unit(b, c, len_bc);
+  float cos_turn = posp_dot(&u_ab, &u_bc);
+  if (cos_turn > 0.999999f) {
+    return INFINITY;  // straight
+  }
+  if (cos_turn < -0.999999f || lim->junction_dev <= 0) {
+    return 0;  // reversal, or exact stop requested
+  }
+
+  // Centripetal acceleration works along (u_bc - u_ab).
+  pos_phys_t acc_dir = posp_unit(&u_ab, &u_bc, posp_dist(&u_ab, &u_bc));
+  float acc = posp_limit_along(&acc_dir, &lim->max_acc);
+
+  // theta: angle between the two segments at b (pi when straight).
+  // Arc tangent to both segments, within junction_dev from b, has radius
+  // r = dev * sin(theta/2) / (1 - sin(theta/2)).
+  float sin_half_theta = sqrtf(0.5f * (1 + cos_turn));
+  float r = lim->junction_dev * sin_half_theta / (1 - sin_half_theta);
+  return sqrtf(acc * r);
+}
+
+void plan_velocities(plan_seg_t* segs, int n, float v_end) {
+  // backward pass: ensure slowing down is possible.
+  // Ramp is computed from the last limiting point, rather than per segment,
+  // as S-curve ramp split into segments would be slower than necessary.
+  // Once the ramp reaches a segment planned before with the same ramp, the
+  // rest is unchanged, thus only the forward pass from there is needed.
+  float v_brake = v_end;
+  float d_brake = 0;
+  int i_fwd = 0;
+  for (int i = n - 1; i >= 0; i--) {
+    if (i < n - 1 && segs[i].planned && segs[i].brake_vel == v_brake &&
+        segs[i].brake_dist == d_brake) {
+      i_fwd = i;
+      break;
+    }
+    segs[i].brake_vel = v_brake;
+    segs[i].brake_dist = d_brake;
+    segs[i].planned = true;
+    if (i == 0) {
+      break;
+    }
+    float v_reach =
+        vel_reachable(&segs[i].lim, v_brake, d_brake + segs[i].len);
+    if (segs[i].entry_max < v_reach) {
+      segs[i].entry_vel = segs[i].entry_max;
+      v_brake = segs[i].entry_max;
+      d_brake = 0;
+    } else {
+      segs[i].entry_vel = v_reach;
+      d_brake += segs[i].len;
+    }
+  }
+
+  // forward pass: ensure speeding up is possible.
+  for (int i = i_fwd; i < n - 1; i++) {
+    float v_reach =
+        vel_reachable(&segs[i].lim, segs[i].entry_vel, segs[i].len);
+    segs[i + 1].entry_vel = fminf(segs[i + 1].entry_vel, v_reach);
+  }
+}
+
+// Precompute length & direction of current segment.
+static void load_segment(path_buffer_t* pb) {
+  float len = posp_dist(&pb->curr_seg_src, &pb->curr_seg_dst);
+  pb->curr_seg_len = mm_to_subnotches(pb, len);
+  if (pb->curr_seg_len == 0) {
+    pb->curr_seg_dir = (pos_phys_t){0};
+    return;
+  }
+  pb->curr_seg_dir = posp_unit(&pb->curr_seg_src, &pb->curr_seg_dst, len);
 }
 
 void pb_init(path_buffer_t* pb,
@@ -27,86 +531,348 @@ void pb_init(path_buffer_t* pb,
              bool dst_is_end) {
   memset(pb, 0, sizeof(path_buffer_t));
 
-  pb->pos_history[0] = *src;
-  pb->num_history = 1;
+  pb->pos = *src;
+  pb->notch_mm = EDM_RESOLUTION_MM;
+  pb->max_retract = INT_MAX;
 
   pb->curr_seg_src = *src;
   pb->curr_seg_dst = *dst;
-  pb->curr_seg_dst_is_end = dst_is_end;
+  load_segment(pb);
+  pb->end_written = dst_is_end;
+}
+
+// Compute length & limits of segment src -> dst. entry_* are cleared.
+static void plan_segment(const plan_limits_t* lim,
+                         const pos_phys_t* src,
+                         const pos_phys_t* dst,
+                         plan_seg_t* seg) {
+  *seg = (plan_seg_t){0};
+  seg->len = posp_dist(src, dst);
+  if (seg->len <= 0) {
+    return;  // can't move
+  }
+  pos_phys_t dir = posp_unit(src, dst, seg->len);
+  seg->lim.max_vel = posp_limit_along(&dir, &lim->max_vel);
+  seg->lim.max_acc = posp_limit_along(&dir, &lim->max_acc);
+  seg->lim.max_jerk = lim->max_jerk;
+}
+
+void pb_set_notch(path_buffer_t* pb, float notch_mm, float max_retract_mm) {
+  pb->notch_mm = notch_mm;
+  pb->max_retract = lroundf(max_retract_mm / notch_mm);
+  load_segment(pb);
+}
+
+void pb_set_blend_tol(path_buffer_t* pb, float tol) {
+  pb->blend_tol = tol;
+}
+
+void pb_set_limits(path_buffer_t* pb, const plan_limits_t* lim) {
+  pb->plan_enabled = true;
+  pb->plan_limits = *lim;
+
+  // Current segment starts from standstill.
+  plan_segment(lim, &pb->curr_seg_src, &pb->curr_seg_dst, &pb->curr_seg_plan);
 }
 
 pos_phys_t pb_get_pos(const path_buffer_t* pb) {
-  int ix_read = (pb->ix_history + EDM_HISTORY_SIZE - pb->notches_retract) %
-                EDM_HISTORY_SIZE;
-  return pb->pos_history[ix_read];
+  return pb->pos;
+}
+
+float pb_get_retract(const path_buffer_t* pb) {
+  return pb->notches_retract * pb->notch_mm;
 }
 
 bool pb_at_end(const path_buffer_t* pb) {
-  if (pb->notches_retract > 0) {
+  return pb->end_written && pb_at_tail(pb);
+}
+
+bool pb_at_tail(const path_buffer_t* pb) {
+  if (pb->notches_retract > 0 || pb->num_queue > 0) {
     return false;
   }
+  return pb->curr_seg_d >= pb->curr_seg_len;
+}
 
-  if (!pb->curr_seg_dst_is_end) {
-    return false;
+float pb_dist_to_seg_end(const path_buffer_t* pb) {
+  int32_t remaining = pb->curr_seg_len - pb->curr_seg_d;
+  if (remaining <= 0) {
+    return 0;
   }
+  // Position only advances by notches, and the notch that overflows is clipped
+  // to the end. Thus round up to notches.
+  int32_t notches = (remaining + PB_SUBNOTCHES - 1) / PB_SUBNOTCHES;
+  int32_t d = (notches + pb->notches_retract) * PB_SUBNOTCHES - pb->fraction;
+  return (d > 0) ? subnotches_to_mm(pb, d) : 0;
+}
+
+const vel_limits_t* pb_seg_limits(const path_buffer_t* pb) {
+  return &pb->curr_seg_plan.lim;
+}
 
-  // TODO: this is ok, but might not be consistent.
-  const pos_phys_t* curr = &pb->pos_history[pb->ix_history];
-  return posp_dist(curr, &pb->curr_seg_dst) <= EDM_RESOLUTION_MM;
+float pb_brake_target(const path_buffer_t* pb, float* vel) {
+  *vel = pb->curr_seg_plan.brake_vel;
+  return pb_dist_to_seg_end(pb) + pb->curr_seg_plan.brake_dist;
+}
+
+// Make the oldest queued point the destination of current segment.
+// Should only be called when queue is not empty.
+static void pop_queue(path_buffer_t* pb) {
+  // Retain current segment for retraction.
+  if (pb->curr_seg_len > 0) {
+    if (pb->num_seg_history == PB_HISTORY_SEGS) {
+      int ix_oldest = (pb->ix_seg_history + 1) % PB_HISTORY_SEGS;
+      pb->seg_history_len -= pb->seg_history[ix_oldest].len;
+      pb->num_seg_history--;
+    }
+    pb->ix_seg_history = (pb->ix_seg_history + 1) % PB_HISTORY_SEGS;
+    pb_hist_seg_t* hist = &pb->seg_history[pb->ix_seg_history];
+    hist->src = pb->curr_seg_src;
+    hist->dir = pb->curr_seg_dir;
+    hist->len = pb->curr_seg_len;
+    pb->seg_history_len += pb->curr_seg_len;
+    pb->num_seg_history++;
+
+    // Drop segments beyond max_retract; they can never be reached.
+    int64_t max_len = (int64_t)pb->max_retract * PB_SUBNOTCHES;
+    while (pb->num_seg_history > 1) {
+      int ix_oldest = (pb->ix_seg_history + PB_HISTORY_SEGS -
+                       pb->num_seg_history + 1) %
+                      PB_HISTORY_SEGS;
+      int32_t len_oldest = pb->seg_history[ix_oldest].len;
+      if (pb->seg_history_len - len_oldest < max_len) {
+        break;
+      }
+      pb->seg_history_len -= len_oldest;
+      pb->num_seg_history--;
+    }
+  }
+
+  pb->curr_seg_src = pb->curr_seg_dst;
+  pb->curr_seg_dst = pb->queue[pb->ix_queue].dst;
+  pb->curr_seg_plan = pb->queue[pb->ix_queue].plan;
+  load_segment(pb);
+  pb->ix_queue = (pb->ix_queue + 1) % PB_QUEUE_SIZE;
+  pb->num_queue--;
+}
+
+// Get i-th point of the path, counting back from the last written point.
+// 0: last written point. Returns NULL if out of range.
+static const pos_phys_t* written_point(const path_buffer_t* pb, int i) {
+  if (i < pb->num_queue) {
+    int ix = (pb->ix_queue + pb->num_queue - 1 - i) % PB_QUEUE_SIZE;
+    return &pb->queue[ix].dst;
+  } else if (i == pb->num_queue) {
+    return &pb->curr_seg_dst;
+  } else if (i == pb->num_queue + 1) {
+    return &pb->curr_seg_src;
+  }
+  return NULL;
+}
+
+// Re-plan velocities of all queued segments.
+static void replan(path_buffer_t* pb) {
+  plan_seg_t segs[PB_QUEUE_SIZE + 1];
+  segs[0] = pb->curr_seg_plan;
+  for (int i = 0; i < pb->num_queue; i++) {
+    segs[i + 1] = pb->queue[(pb->ix_queue + i) % PB_QUEUE_SIZE].plan;
+  }
+  plan_velocities(segs, pb->num_queue + 1, 0);
+  pb->curr_seg_plan = segs[0];
+  for (int i = 0; i < pb->num_queue; i++) {
+    pb->queue[(pb->ix_queue + i) % PB_QUEUE_SIZE].plan = segs[i + 1];
+  }
+}
+
+static inline int mini(int a, int b) {
+  return (a < b) ? a : b;
 }
 
 bool pb_can_write(const path_buffer_t* pb) {
-  return !pb->curr_seg_dst_is_end && !pb->next_seg_avail;
+  // Blending can add up to PB_BLEND_MAX_CHORDS points per write.
+  int room = (pb->blend_tol > 0) ? PB_BLEND_MAX_CHORDS + 1 : 1;
+  return !pb->end_written && pb->num_queue + room <= PB_QUEUE_SIZE;
+}
+
+// Append a point to the queue, with velocity at its start point (i.e. the last
+// written point) limited to v_max.
+static void push_point(path_buffer_t* pb, const pos_phys_t* pos, float v_max) {
+  int ix_write = (pb->ix_queue + pb->num_queue) % PB_QUEUE_SIZE;
+  pb_seg_t* seg = &pb->queue[ix_write];
+  seg->dst = *pos;
+  seg->plan = (plan_seg_t){0};
+  if (pb->plan_enabled) {
+    const pos_phys_t* prev = written_point(pb, 0);
+    const pos_phys_t* prev_prev = written_point(pb, 1);
+    plan_segment(&pb->plan_limits, prev, pos, &seg->plan);
+    float v_junction =
+        posp_junction_vel(prev_prev, prev, pos, &pb->plan_limits);
+    seg->plan.entry_max =
+        fminf(fminf(v_junction, v_max), seg->plan.lim.max_vel);
+  }
+  pb->num_queue++;
+}
+
+// Replace the last written point b of a -> b -> c (c: not yet written) with an
+// arc, tangent to both segments and within blend_tol from b.
+// Returns max velocity along the arc (INFINITY if not blended).
+static float blend_corner(path_buffer_t* pb, const pos_phys_t* c) {
+  if (pb->num_queue == 0) {
+    return INFINITY;  // b is already being traveled
+  }
+  pos_phys_t a = *written_point(pb, 1);
+  pos_phys_t b = *written_point(pb, 0);
+  float len_ab = posp_dist(&a, &b);
+  float len_bc = posp_dist(&b, c);
+  if (len_ab < 1e-6f || len_bc < 1e-6f) {
+    return INFINITY;
+  }
+  pos_phys_t u_ab = posp_unit(&a, &b, len_ab);
+  pos_phys_t u_bc = posp_unit(&b, c, len_bc);
+  float cos_turn = posp_dot(&u_ab, &u_bc);
+  if (cos_turn > 0.999999f || cos_turn < -0.999999f) {
+    return INFINITY;  // straight, or reversal (can't be blended)
+  }
+
+  // Arc of radius r is r * (1 / cos(turn/2) - 1) away from b, and touches
+  // the segments at l = r * tan(turn/2) from b.
+  // l is limited to half of segments, not to overlap with neighbor blends.
+  float turn = acosf(cos_turn);
+  float tan_half = tanf(0.5f * turn);
+  float r = pb->blend_tol / (1 / cosf(0.5f * turn) - 1);
+  float l = fminf(r * tan_half, 0.5f * fminf(len_ab, len_bc));
+  if (l < pb->notch_mm) {
+    return INFINITY;  // too small to matter
+  }
+  r = l / tan_half;
+
+  // Split into chords, each deviating at most a notch from the arc.
+  int n_chords = PB_BLEND_MAX_CHORDS;
+  if (r > pb->notch_mm) {
+    float max_chord_angle = 2 * acosf(1 - pb->notch_mm / r);
+    n_chords = (int)ceilf(turn / max_chord_angle);
+    n_chords = mini(n_chords < 1 ? 1 : n_chords, PB_BLEND_MAX_CHORDS);
+  }
+
+  // Unit vector perpendicular to u_ab, towards inside of the turn.
+  float sin_turn = sinf(turn);
+  pos_phys_t u_in = posp_add_scaled(&u_bc, -cos_turn, &u_ab);
+  u_in = posp_scale(&u_in, 1 / sin_turn);
+  float v_arc = INFINITY;
+  if (pb->plan_enabled) {
+    // Centripetal acceleration works along (u_bc - u_ab) on average.
+    pos_phys_t acc_dir = posp_unit(&u_ab, &u_bc, posp_dist(&u_ab, &u_bc));
+    v_arc = sqrtf(posp_limit_along(&acc_dir, &pb->plan_limits.max_acc) * r);
+  }
+
+  pb->num_queue--;  // remove b
+  pos_phys_t arc_start = posp_add_scaled(&b, -l, &u_ab);
+  push_point(pb, &arc_start, INFINITY);
+  for (int i = 1; i <= n_chords; i++) {
+    float angle = turn * i / n_chords;
+    float k_ab = r * sinf(angle);
+    float k_in = r * (1 - cosf(angle));
+    pos_phys_t p = posp_add_scaled(&arc_start, k_ab, &u_ab);
+    p = posp_add_scaled(&p, k_in, &u_in);
+    push_point(pb, &p, v_arc);
+  }
+  return v_arc;
 }
 
 void pb_write(path_buffer_t* pb, const pos_phys_t* next_pos, bool is_end) {
-  pb->next_pos = *next_pos;
-  pb->next_pos_is_end = is_end;
-  pb->next_seg_avail = true;
+  if (!pb_can_write(pb)) {
+    return;
+  }
+  float v_max = INFINITY;
+  if (pb->blend_tol > 0) {
+    v_max = blend_corner(pb, next_pos);
+  }
+  push_point(pb, next_pos, v_max);
+  pb->end_written = is_end;
+  if (pb->plan_enabled) {
+    replan(pb);
+  }
+
+  // If current segment was clipped at its end, continue to the new segment
+  // right away. This keeps pb_dist_to_seg_end() non-zero unless at tail.
+  // Not while retracted: popping can evict history that the retraction
+  // reaches into. pb_move() pops once it's back at the end.
+  if (pb->num_queue == 1 && pb->notches_retract == 0 &&
+      pb->curr_seg_d >= pb->curr_seg_len) {
+    pb->curr_seg_d = 0;
+    pop_queue(pb);
+  }
 }
 
 bool pb_is_ready(const path_buffer_t* pb) {
-  return pb->curr_seg_dst_is_end || pb->next_seg_avail;
+  return pb->end_written || pb->num_queue > 0;
 }
 
-static inline int mini(int a, int b) {
-  return (a < b) ? a : b;
+static inline pos_phys_t point_on_seg(const path_buffer_t* pb,
+                                      const pos_phys_t* src,
+                                      const pos_phys_t* dir,
+                                      int32_t d) {
+  return posp_add_scaled(src, subnotches_to_mm(pb, d), dir);
 }
 
-static inline void push_history(path_buffer_t* pb, const pos_phys_t* pos) {
-  pb->ix_history = (pb->ix_history + 1) % EDM_HISTORY_SIZE;
-  pb->pos_history[pb->ix_history] = *pos;
-  if (pb->num_history < EDM_HISTORY_SIZE) {
-    pb->num_history++;
+// Rebuild current position from curr_seg_d & notches_retract.
+static void update_pos(path_buffer_t* pb) {
+  int32_t d = pb->curr_seg_d - pb->notches_retract * PB_SUBNOTCHES;
+  if (d >= pb->curr_seg_len) {
+    pb->pos = pb->curr_seg_dst;  // exactly at the end
+    return;
+  } else if (d >= 0) {
+    pb->pos = point_on_seg(pb, &pb->curr_seg_src, &pb->curr_seg_dir, d);
+    return;
+  }
+
+  // Walk back through history.
+  for (int i = 0; i < pb->num_seg_history; i++) {
+    const pb_hist_seg_t* hist =
+        &pb->seg_history[(pb->ix_seg_history + PB_HISTORY_SEGS - i) %
+                         PB_HISTORY_SEGS];
+    d += hist->len;
+    if (d >= 0) {
+      pb->pos = point_on_seg(pb, &hist->src, &hist->dir, d);
+      return;
+    }
   }
+  // Shouldn't happen, as notches_retract is limited by history.
 }
 
 bool pb_move(path_buffer_t* pb, float d) {
   // dist <-> notch + fraction conversion.
-  pb->fraction += d;
-  int d_notches = truncf(pb->fraction * (1.0f / EDM_RESOLUTION_MM));
+  pb->fraction += mm_to_subnotches(pb, d);
+  int d_notches = pb->fraction / PB_SUBNOTCHES;  // truncated towards 0
   if (d_notches == 0) {
     // nothing to do.
     return true;
   }
-  pb->fraction -= d_notches * EDM_RESOLUTION_MM;
+  pb->fraction -= d_notches * PB_SUBNOTCHES;
 
-  // Consume d_ticks by moving history.
+  // Consume d_ticks by moving in history.
   if (d_notches < 0) {
     // go back in history as much as possible.
-    int available = pb->num_history - pb->notches_retract - 1;  // always >= 0
+    int64_t traveled = (int64_t)pb->curr_seg_d + pb->seg_history_len;
+    int retractable =
+        (int)(traveled / PB_SUBNOTCHES < pb->max_retract
+                  ? traveled / PB_SUBNOTCHES
+                  : pb->max_retract);
+    int available = retractable - pb->notches_retract;  // always >= 0
+    bool ok = true;
     if (d_notches < -available) {
       // Retract limit exceeded. Clip to furthest possible with error.
-      pb->notches_retract += available;
-      return false;
-    } else {
-      pb->notches_retract += -d_notches;
-      return true;
+      d_notches = -available;
+      ok = false;
     }
+    pb->notches_retract += -d_notches;
+    update_pos(pb);
+    return ok;
   } else {
     // for forward in history as much as possible.
     if (pb->notches_retract > d_notches) {
       pb->notches_retract -= d_notches;
+      update_pos(pb);
       return true;
     } else {
       d_notches -= pb->notches_retract;
@@ -115,44 +881,18 @@ bool pb_move(path_buffer_t* pb, float d) {
     }
   }
 
-  // When this point is reached, d_notches > 0, and we need to actually move
+  // When this point is reached, d_notches >= 0, and we need to actually move
   // forward.
-  for (int i = 0; i < d_notches; i++) {
-    bool clipped = false;
-    float seg_len = posp_dist(&pb->curr_seg_src, &pb->curr_seg_dst);
-
-    pb->curr_seg_d += EDM_RESOLUTION_MM;
-    if (pb->curr_seg_d >= seg_len) {
-      // overflown
-      if (pb->curr_seg_dst_is_end || !pb->next_seg_avail) {
-        // should not (or cannot) move to next segment.
-        pb->curr_seg_d = seg_len;
-        clipped = true;
-      } else {
-        // move to next segment.
-        pb->curr_seg_d -= seg_len;
-        pb->curr_seg_src = pb->curr_seg_dst;
-        pb->curr_seg_dst = pb->next_pos;
-        pb->curr_seg_dst_is_end = pb->next_pos_is_end;
-        pb->next_seg_avail = false;
-      }
-    }
-
-    // Record point to history.
-    pos_phys_t pos;
-    if (seg_len < EDM_RESOLUTION_MM) {
-      // avoid division error.
-      pos = pb->curr_seg_src;
-    } else {
-      posp_interp(&pb->curr_seg_src, &pb->curr_seg_dst,
-                  pb->curr_seg_d / seg_len, &pos);
-    }
-    push_history(pb, &pos);
-
-    // If clipped, history nor seg_d will not move further. (not an error)
-    if (clipped) {
-      break;
-    }
+  pb->curr_seg_d += d_notches * PB_SUBNOTCHES;
+  // overflown; move to next segment(s) as long as queued.
+  while (pb->curr_seg_d >= pb->curr_seg_len && pb->num_queue > 0) {
+    pb->curr_seg_d -= pb->curr_seg_len;
+    pop_queue(pb);
+  }
+  if (pb->curr_seg_d >= pb->curr_seg_len) {
+    // end of path, or next segment is not written yet. (not an error)
+    pb->curr_seg_d = pb->curr_seg_len;
   }
+  update_pos(pb);
   return true;
 }
@@ -7,16 +7,35 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
-// Positional resolution of EDM control in mm.
+// Default positional resolution of EDM control in mm. (see pb_set_notch())
 // Internally, everything is handled by "notch" of this length along motion
 // path.
 #define EDM_RESOLUTION_MM 0.005f
 
-// EDM_RESOLUTION_MM * (EDM_HISTORY_SIZE - 1) will be the maximum retractable
-// distance. e.g. if EDM_RESOLUTION_MM = 0.005, EDM_HISTORY_SIZE = 201, then
-// retraction up to 1.0 mm is possible.
-#define EDM_HISTORY_SIZE 201
+// Distance along path is handled in fixed-point "sub-notches" of
+// notch / PB_SUBNOTCHES, to avoid accumulating rounding errors.
+// Power of 2, so that whole notches convert to mm exactly.
+#define PB_SUBNOTCHES 1024
+
+// Number of traveled segments (excluding current one) retained for retraction.
+// Retraction is possible through the retained segments, regardless of their
+// lengths.
+#define PB_HISTORY_SEGS 32
+
+// Number of points that can be written ahead of the current segment.
+// Deeper queue allows motion to flow through more segments without draining,
+// at the cost of RAM.
+#define PB_QUEUE_SIZE 32
+
+// Max number of chords to approximate a blended corner.
+#define PB_BLEND_MAX_CHORDS 4
+
+// Number of coordinated axes: linear X, Y, Z (mm) and rotary A, B, C
+// (rotations). Axis index i (0 ~ AXIS_COUNT - 1) follows field order of
+// pos_phys_t.
+#define AXIS_COUNT 6
 
 /** Represents a single physical coordinate. (i.e. coordinates specification in
  * G-code)
@@ -25,10 +44,19 @@ typedef struct {
   float x;
   float y;
   float z;
-  // a, b, c etc.
+  float a;
+  float b;
+  float c;
 } pos_phys_t;
 
-/** Compute distance between two pos_phys_t points.
+/** Get coordinate of axis i. */
+float posp_get(const pos_phys_t* p, int axis);
+
+/** Set coordinate of axis i. Invalid axis is ignored. */
+void posp_set(pos_phys_t* p, int axis, float value);
+
+/** Compute distance between two pos_phys_t points, over all axes (1 rotation
+ * counts as 1 mm).
  * @return distance in mm
  */
 float posp_dist(const pos_phys_t* a, const pos_phys_t* b);
@@ -41,10 +69,192 @@ void posp_interp(const pos_phys_t* a,
                  float t,
                  pos_phys_t* out);
 
+/** Plane of circular arcs, selected by G17/G18/G19. */
+typedef enum {
+  ARC_PLANE_XY,  // G17
+  ARC_PLANE_ZX,  // G18
+  ARC_PLANE_YZ,  // G19
+} arc_plane_t;
+
+/** Generates chord end points of a circular (or helical) arc. */
+typedef struct {
+  arc_plane_t plane;
+  // In plane coordinates (u, v) and linear axis w, normal to the plane.
+  float center_u, center_v;
+  float radius_start, radius_end;
+  float angle_start;
+  float sweep;  // signed angle. positive: counter-clockwise
+  float w_start, w_end;
+  pos_phys_t start, end;  // other axes move linearly from start to end
+  int num_chords;
+  int ix_chord;  // number of points generated so far
+} arc_iter_t;
+
+/** Compute arc center from radius (G2/G3 R form).
+ * Positive radius selects the arc <= 180 deg, negative selects > 180 deg.
+ * @return false if the end point is too far away for the radius.
+ */
+bool arc_center_from_radius(const pos_phys_t* start,
+                            const pos_phys_t* end,
+                            float radius,
+                            bool cw,
+                            arc_plane_t plane,
+                            pos_phys_t* center);
+
+/** Initialize arc from start to end around center (only plane coordinates of
+ * center are used). Full circle is generated if start and end are same in the
+ * plane. Axis normal to the plane moves linearly (helix).
+ * Chords deviate from the arc by at most chord_tol.
+ * @return false if radii at start and end don't match.
+ */
+bool arc_init(arc_iter_t* it,
+              const pos_phys_t* start,
+              const pos_phys_t* end,
+              const pos_phys_t* center,
+              bool cw,
+              arc_plane_t plane,
+              float chord_tol);
+
+/** Get next chord end point. The last point is exactly the end.
+ * @return false if all points have been generated.
+ */
+bool arc_next(arc_iter_t* it, pos_phys_t* out);
+
+/** Generates points of a cubic Bezier curve, adaptively subdivided so that
+ * chords deviate from the curve by at most tol.
+ */
+typedef struct {
+  pos_phys_t p[4];  // start, control 1, control 2, end
+  // Second derivative is 6 * ((1 - t) * d2_start + t * d2_end).
+  pos_phys_t d2_start, d2_end;
+  float tol;
+  float t;  // parameter of the last generated point
+} bezier_iter_t;
+
+void bezier_init(bezier_iter_t* it,
+                 const pos_phys_t* start,
+                 const pos_phys_t* ctrl1,
+                 const pos_phys_t* ctrl2,
+                 const pos_phys_t* end,
+                 float tol);
+
+/** Get next chord end point. The last point is exactly the end.
+ * @return false if all points have been generated.
+ */
+bool bezier_next(bezier_iter_t* it, pos_phys_t* out);
+
+/** Kinematic limits of motion along a path. */
+typedef struct {
+  float max_vel;   // mm/s
+  float max_acc;   // mm/s^2
+  float max_jerk;  // mm/s^3. 0 means unlimited (trapezoidal profile).
+} vel_limits_t;
+
+/** State of a velocity profile. Zero-initialize to start from standstill. */
+typedef struct {
+  float vel;  // mm/s
+  float acc;  // mm/s^2
+} vel_state_t;
+
+/** Compute distance needed to change velocity between v0 and v1 (in either
+ * direction), starting and ending with zero acceleration.
+ * @return distance in mm
+ */
+float vel_ramp_dist(const vel_limits_t* lim, float v0, float v1);
+
+/** Compute maximum velocity (capped by max_vel) from which velocity can be
+ * reduced to v_end within distance d.
+ * Because ramps are symmetric, this is also the maximum velocity reachable
+ * from v_end within distance d.
+ */
+float vel_reachable(const vel_limits_t* lim, float v_end, float d);
+
+/** Advance velocity profile by one tick of dt seconds.
+ *
+ * Velocity ramps up towards max_vel, while making sure that it can be
+ * reduced to v_end until d_remaining is traveled. Trapezoidal profile is
+ * generated if max_jerk is 0, S-curve profile otherwise.
+ *
+ * @return distance to travel in this tick (mm). Never exceeds d_remaining if
+ * v_end is 0. Otherwise, it can pass beyond d_remaining at around v_end.
+ */
+float vel_step(vel_state_t* st,
+               const vel_limits_t* lim,
+               float d_remaining,
+               float v_end,
+               float dt);
+
+/** Kinematic limits of axes, used for planning velocity along a path. */
+typedef struct {
+  pos_phys_t max_vel;  // mm/s of each axis
+  pos_phys_t max_acc;  // mm/s^2 of each axis
+  float max_jerk;      // mm/s^3. 0 means unlimited.
+  // Allowed deviation from the path at corners (mm), to determine corner
+  // velocity. 0 means exact stop at every corner.
+  float junction_dev;
+} plan_limits_t;
+
+/** Compute max length of a vector along unit direction dir, such that each
+ * axis component stays within limits.
+ * e.g. dir=(0.6, 0.8, 0) with limits=(100, 100, 100) -> 125
+ */
+float posp_limit_along(const pos_phys_t* dir, const pos_phys_t* limits);
+
+/** Compute max velocity to pass the corner b of path a -> b -> c.
+ * Uses junction deviation model: velocity of a virtual arc within
+ * junction_dev of the corner, under centripetal acceleration limited by
+ * max_acc.
+ * @return velocity in mm/s. INFINITY if the path is straight.
+ */
+float posp_junction_vel(const pos_phys_t* a,
+                        const pos_phys_t* b,
+                        const pos_phys_t* c,
+                        const plan_limits_t* lim);
+
+/** A segment for velocity planning. */
+typedef struct {
+  float len;         // mm
+  vel_limits_t lim;  // limits along the segment
+  float entry_max;   // max velocity at the start of the segment (mm/s)
+  float entry_vel;   // planned velocity at the start of the segment (mm/s)
+  // Next point where velocity must be slowed down to, after this segment.
+  float brake_dist;  // distance from the end of the segment (mm)
+  float brake_vel;   // velocity at the point (mm/s)
+  // Planned before. len, lim & entry_max must be kept unchanged after this.
+  bool planned;
+} plan_seg_t;
+
+/** Plan velocities of consecutive segments, by a backward pass (to be able
+ * to slow down to v_end at the end of the last segment) and a forward pass
+ * (to be reachable from segs[0].entry_vel, which is kept as-is).
+ * Writes segs[1..n-1].entry_vel and segs[0..n-1].brake_*.
+ *
+ * Braking is planned over multiple segments until the next limiting corner,
+ * so short collinear segments don't reduce velocity.
+ *
+ * Segments already planned are only re-planned as far back as their braking
+ * changes, so appending a segment after a limiting corner is cheap.
+ */
+void plan_velocities(plan_seg_t* segs, int n, float v_end);
+
+/** A segment (from previous point to dst) queued in path_buffer_t. */
+typedef struct {
+  pos_phys_t dst;
+  plan_seg_t plan;
+} pb_seg_t;
+
+/** A traveled segment retained in path_buffer_t for retraction. */
+typedef struct {
+  pos_phys_t src;
+  pos_phys_t dir;  // unit vector
+  int32_t len;     // in sub-notches
+} pb_hist_seg_t;
+
 // path_buffer_t represents a path and a current position, typed by pos_phys_t.
 //
 // The path is a sequence of line segments. It can be extended continuously
-// while being used, until its end is marked.
+// while being used, until its end is marked. Up to PB_QUEUE_SIZE points can be
+// written ahead of the current segment.
 //
 // Current position is controlled by pb_move(), both forward and backward motion
 // is allowed. path_buffer_t guarantees that the position is always on the
@@ -52,34 +262,64 @@ void posp_interp(const pos_phys_t* a,
 //
 // Furthest traveled position is also tracked.
 // pb_move() reports error if it tries to go back beyond maximum retractable
-// distance (see EDM_HISTORY_SIZE).
+// distance (see PB_HISTORY_SEGS).
 typedef struct {
-  // Ring buffer. History is recorded at EDM_RESOLUTION_MM "notches".
-  pos_phys_t pos_history[EDM_HISTORY_SIZE];
-  // index of current position in pos_history.
-  int ix_history;
-  // number of valid elements in pos_history. always in [1, EDM_HISTORY_SIZE]
-  int num_history;
+  // Ring buffer of traveled segments, before current segment.
+  pb_hist_seg_t seg_history[PB_HISTORY_SEGS];
+  // index of the newest segment in seg_history.
+  int ix_seg_history;
+  // number of valid elements in seg_history. always in [0, PB_HISTORY_SEGS]
+  int num_seg_history;
+  // total length of seg_history, in sub-notches. 64-bit, as it can exceed
+  // int32 range for fine notches. Segments beyond max_retract are dropped.
+  int64_t seg_history_len;
 
   // 0: current position is furthest (curr_seg_d).
-  // positive: notches_retract==1: 1 previous tick in history, and so on.
-  // [0, num_history - 1] is allowed.
+  // positive: retracted from furthest by notches_retract notches along path.
+  // Limited by curr_seg_d + seg_history_len, and max_retract.
   int notches_retract;
 
+  // Length of a notch in mm.
+  float notch_mm;
+  // Max allowed notches_retract.
+  int max_retract;
+
+  // Current position, rebuilt from above when moved.
+  pos_phys_t pos;
+
   // Point on the segment corresponding to notches_retract == 0.
-  float curr_seg_d;
+  // In sub-notches from curr_seg_src.
+  int32_t curr_seg_d;
   pos_phys_t curr_seg_src;
   pos_phys_t curr_seg_dst;
-  bool curr_seg_dst_is_end;
+  // Precomputed when the segment is loaded.
+  int32_t curr_seg_len;     // in sub-notches
+  pos_phys_t curr_seg_dir;  // unit vector. zero if the segment is too short.
+  plan_seg_t curr_seg_plan;
 
-  // single-element buffer for writing next segment.
-  bool next_seg_avail;
-  pos_phys_t next_pos;
-  bool next_pos_is_end;
+  // Ring buffer of points written by pb_write(), not yet reached by current
+  // segment. Each point is the destination of a segment that starts from the
+  // previous point (or curr_seg_dst for the oldest one).
+  pb_seg_t queue[PB_QUEUE_SIZE];
+  // index of the oldest point in queue.
+  int ix_queue;
+  // number of valid points in queue. always in [0, PB_QUEUE_SIZE]
+  int num_queue;
+
+  // true if the last written point (newest in queue, or curr_seg_dst if queue
+  // is empty) is the end of the path.
+  bool end_written;
 
   // internal_pos (notch-aligned) + fraction = current pb_move() position.
-  // always |fraction| < EDM_RESOLUTION_MM
-  float fraction;
+  // In sub-notches. always |fraction| < PB_SUBNOTCHES
+  int32_t fraction;
+
+  // Corners are replaced by arcs within this distance (mm). 0: no blending.
+  float blend_tol;
+
+  // Velocity planning. Only done when plan_enabled.
+  bool plan_enabled;
+  plan_limits_t plan_limits;
 } path_buffer_t;
 
 /** Initialize path buffer with single line segment.
@@ -90,18 +330,66 @@ void pb_init(path_buffer_t* pb,
              const pos_phys_t* dst,
              bool dst_is_end);
 
+/** Set length of a notch (mm), and max retraction distance (mm).
+ * Should be called right after pb_init(), before any pb_move().
+ * Default: EDM_RESOLUTION_MM notch, retraction limited only by history.
+ */
+void pb_set_notch(path_buffer_t* pb, float notch_mm, float max_retract_mm);
+
+/** Set tolerance of corner blending (mm), applied to following pb_write().
+ * Corners are replaced by arcs (split into up to PB_BLEND_MAX_CHORDS chords)
+ * that deviate from the original corner by at most tol.
+ * 0 (default) keeps the exact corners.
+ */
+void pb_set_blend_tol(path_buffer_t* pb, float tol);
+
+/** Enable velocity planning of the path with given limits.
+ * Should be called right after pb_init(), before any pb_write().
+ * Without this, all planned velocities are 0.
+ */
+void pb_set_limits(path_buffer_t* pb, const plan_limits_t* lim);
+
 /** Get the current (notch-aligned) position. */
 pos_phys_t pb_get_pos(const path_buffer_t* pb);
 
+/** Get distance (mm) of the current position behind the furthest point. */
+float pb_get_retract(const path_buffer_t* pb);
+
 /** Get if the current position is at the end of the path. */
 bool pb_at_end(const path_buffer_t* pb);
 
-/** Check if path buffer has room for pb_write() calls. */
+/** Get if the current position is at the last point written so far.
+ * Unlike pb_at_end(), this is true even if the path can be extended further.
+ */
+bool pb_at_tail(const path_buffer_t* pb);
+
+/** Get distance to pass to pb_move() for reaching the end of current segment.
+ * This is where the path turns a corner (or stops if at tail).
+ * Because of notch discretization, this can be slightly longer than the
+ * geometric distance.
+ */
+float pb_dist_to_seg_end(const path_buffer_t* pb);
+
+/** Get velocity limits along current segment. */
+const vel_limits_t* pb_seg_limits(const path_buffer_t* pb);
+
+/** Get distance to the next point on the path where velocity must be slowed
+ * down to, and the velocity at the point (0 if the path currently ends there).
+ * The distance is measured like pb_dist_to_seg_end().
+ */
+float pb_brake_target(const path_buffer_t* pb, float* vel);
+
+/** Check if path buffer has room for pb_write() calls.
+ * When blending, room for the arc points is also needed.
+ */
 bool pb_can_write(const path_buffer_t* pb);
 
 /** Write next point of path.
  * Should only be called when pb_can_write() is true.
- * (Otherwise, previous writes might get overwritten.)
+ * (Otherwise, the write is ignored.)
+ *
+ * If blending is enabled, the corner at the previously written point is
+ * replaced by an arc (unless current segment already ends there).
  *
  * If is_end is false, further pb_write is allowed.
  * If is_end is true, next_pos will be the end of the path, and no further
@@ -115,7 +403,7 @@ bool pb_is_ready(const path_buffer_t* pb);
 /** Move current position along the path by distance d.
  * d can be positive (forward), or negative (backward).
  *
- * Actual position is discretized by EDM_RESOLUTION_MM notches,
+ * Actual position is discretized by notches,
  * so tiny moves will not appear immediately in pb_get_pos().
  *
  * If the resulting position is out of bounds of current path or retraction
@@ -2,16 +2,18 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 #include "motor.h"
 #include "comm.h"
+#include "step_base.h"
 #include "system.h"
 
 #include <drivers/tmc_driver.h>
 
 #include <zephyr/drivers/counter.h>
+#include <zephyr/drivers/gpio.h>
 #include <zephyr/kernel.h>
 
 // Hardware devices
-static const struct device* step_gen_cnt =
-    DEVICE_DT_GET(DT_NODELABEL(step_gen_cnt));
+static const struct device* step_sched_cnt =
+    DEVICE_DT_GET(DT_NODELABEL(step_sched_cnt));
 static const struct device* motor0 = DEVICE_DT_GET(DT_NODELABEL(motor0));
 static const struct device* motor1 = DEVICE_DT_GET(DT_NODELABEL(motor1));
 static const struct device* motor2 = DEVICE_DT_GET(DT_NODELABEL(motor2));
@@ -20,35 +22,159 @@ static const struct device* motor4 = DEVICE_DT_GET(DT_NODELABEL(motor4));
 static const struct device* motor5 = DEVICE_DT_GET(DT_NODELABEL(motor5));
 static const struct device* motor6 = DEVICE_DT_GET(DT_NODELABEL(motor6));
 
-// Step pulse generation state machine
-typedef enum {
-  STEP_IDLE,        // No stepping in progress
-  STEP_PULSE_HIGH,  // Step pin is HIGH (1 tick)
-  STEP_PULSE_LOW,   // Step pin is LOW, waiting before next step (1 tick)
-} step_state_t;
+// Step & dir pins of motors, written directly by step ISR
+#define MOTOR_GPIO(n, prop) GPIO_DT_SPEC_GET(DT_NODELABEL(motor##n), prop)
+static const struct gpio_dt_spec step_gpios[MOTOR_COUNT] = {
+    MOTOR_GPIO(0, step_gpios), MOTOR_GPIO(1, step_gpios),
+    MOTOR_GPIO(2, step_gpios), MOTOR_GPIO(3, step_gpios),
+    MOTOR_GPIO(4, step_gpios), MOTOR_GPIO(5, step_gpios),
+    MOTOR_GPIO(6, step_gpios)};
+static const struct gpio_dt_spec dir_gpios[MOTOR_COUNT] = {
+    MOTOR_GPIO(0, dir_gpios), MOTOR_GPIO(1, dir_gpios),
+    MOTOR_GPIO(2, dir_gpios), MOTOR_GPIO(3, dir_gpios),
+    MOTOR_GPIO(4, dir_gpios), MOTOR_GPIO(5, dir_gpios),
+    MOTOR_GPIO(6, dir_gpios)};
+
+// Step timing
+static const uint32_t STEP_MIN_INTERVAL_US = 4;  // max 250k steps/s
+static const uint32_t STEP_PULSE_US = 1;         // TMC2209 needs >= 100ns
+
+// Tick rate of step_sched_cnt (Hz). Step times are in its ticks.
+static uint32_t step_cnt_freq;
 
 // Motor idle timeout configuration
-static const uint32_t STEP_ISR_PERIOD_US = 30;  // ISR period in microseconds
+static const uint32_t IDLE_CHECK_PERIOD_MS = 10;  // Timeout resolution
+
+// Port-batched pin writes: pin changes are accumulated into per-port masks,
+// and each port is written once by batch_flush().
+typedef struct {
+  const struct device* port;
+  gpio_port_pins_t set;  // pending pins to set (raw)
+  gpio_port_pins_t clr;  // pending pins to clear (raw)
+} batch_port_t;
+
+typedef struct {
+  uint8_t port_ix;       // index in batch_ports
+  gpio_port_pins_t bit;  // pin mask in the port
+  bool inverted;         // active-low
+} batch_pin_t;
+
+static batch_port_t batch_ports[2 * MOTOR_COUNT];
+static int num_batch_ports;
+
+// Resolve pin to its port (registered on first use) & mask
+static void batch_pin_init(batch_pin_t* pin, const struct gpio_dt_spec* spec) {
+  int ix = 0;
+  while (ix < num_batch_ports && batch_ports[ix].port != spec->port) {
+    ix++;
+  }
+  if (ix == num_batch_ports) {
+    batch_ports[num_batch_ports++] = (batch_port_t){.port = spec->port};
+  }
+  *pin = (batch_pin_t){.port_ix = ix,
+                       .bit = BIT(spec->pin),
+                       .inverted = (spec->dt_flags & GPIO_ACTIVE_LOW) != 0};
+}
+
+// Set logical pin value at next batch_flush()
+static inline void batch_set(const batch_pin_t* pin, bool value) {
+  batch_port_t* port = &batch_ports[pin->port_ix];
+  if (value != pin->inverted) {
+    port->set |= pin->bit;
+  } else {
+    port->clr |= pin->bit;
+  }
+}
+
+// Write pending pin values, once per port
+static void batch_flush() {
+  for (int i = 0; i < num_batch_ports; i++) {
+    batch_port_t* port = &batch_ports[i];
+    if (port->set || port->clr) {
+      gpio_port_set_clr_bits_raw(port->port, port->set, port->clr);
+      port->set = 0;
+      port->clr = 0;
+    }
+  }
+}
 
 // Per-motor step generation state
 typedef struct {
   const struct device* device;  // Motor device reference
 
-  volatile int target_steps;   // Target position in microsteps
+  // Producer side (motor_move_targets etc.)
+  step_gen_t gen;      // Generates runs from targets
+  uint32_t move_time;  // Start time of next motor_move_targets() period
+  step_queue_t queue;  // Runs to be executed by step ISR
+  // Step ISR side
+  int run_steps;               // Steps done in the oldest run of queue
   volatile int current_steps;  // Current position in microsteps
-
-  bool current_direction;   // Current direction state
-  step_state_t step_state;  // Current state machine state
-
-  bool always_energized;        // If true, never de-energize due to timeout
-  uint32_t idle_timeout_ticks;  // Timeout in ticks (only used if
-                                // !always_energized)
-  bool energized;               // Current energization state
-  uint32_t idle_ticks;          // Ticks since motor became idle
+  bool current_direction;      // Current direction state
+  batch_pin_t step_pin;
+  batch_pin_t dir_pin;
+
+  bool always_energized;     // If true, never de-energize due to timeout
+  uint32_t idle_timeout_ms;  // Timeout (only used if !always_energized)
+  bool energized;            // Current energization state
+  uint32_t idle_since_ms;    // Uptime when motor became idle
 } motor_step_state_t;
 
 static motor_step_state_t motor_states[MOTOR_COUNT];
 
+// Protects step ISR state and alarm between producers and ISRs.
+static struct k_spinlock step_lock;
+static bool alarm_armed;
+static uint32_t alarm_time;
+// Step counter is stopped while no step is queued.
+static bool step_cnt_running;
+
+// Timer for de-energize timeout
+static struct k_timer idle_timer;
+
+static void step_alarm_handler(const struct device* dev,
+                               uint8_t chan_id,
+                               uint32_t ticks,
+                               void* user_data);
+
+// Convert µs to step time.
+static uint32_t step_time_from_us(uint32_t us) {
+  return (uint32_t)(((uint64_t)us * step_cnt_freq << STEP_TIME_FRAC_BITS) /
+                    1000000);
+}
+
+// Current step time
+static uint32_t step_time_now() {
+  uint32_t ticks;
+  counter_get_value(step_sched_cnt, &ticks);
+  return STEP_TIME_TICKS(ticks);
+}
+
+// Make sure step ISR runs at (or before) time.
+static void arm_alarm_locked(uint32_t time) {
+  if (alarm_armed && (int32_t)(time - alarm_time) >= 0) {
+    return;  // will run earlier anyway
+  }
+  if (!step_cnt_running) {
+    counter_start(step_sched_cnt);
+    step_cnt_running = true;
+  }
+  // Round up, not to run before time.
+  int32_t delta = (int32_t)(time - step_time_now());
+  int32_t delta_ticks =
+      (delta + (1 << STEP_TIME_FRAC_BITS) - 1) >> STEP_TIME_FRAC_BITS;
+  struct counter_alarm_cfg alarm_cfg = {
+      .callback = step_alarm_handler,
+      .ticks = delta_ticks > 1 ? delta_ticks : 1,
+      .flags = 0,  // relative
+  };
+  if (alarm_armed) {
+    counter_cancel_channel_alarm(step_sched_cnt, 0);
+  }
+  counter_set_channel_alarm(step_sched_cnt, 0, &alarm_cfg);
+  alarm_armed = true;
+  alarm_time = time;
+}
+
 // Helper to ensure motor energization state
 static inline void ensure_energized(motor_step_state_t* motor, bool energize) {
   if (motor->energized != energize) {
@@ -57,62 +183,116 @@ static inline void ensure_energized(motor_step_state_t* motor, bool energize) {
   }
 }
 
-// Process step generation for a single motor
-static void process_motor_step(motor_step_state_t* motor) {
-  switch (motor->step_state) {
-    case STEP_IDLE:
-      if (motor->current_steps != motor->target_steps) {
-        // Need to step toward target - ensure energized
-        motor->idle_ticks = 0;
-        ensure_energized(motor, true);
-
-        bool dir = (motor->target_steps > motor->current_steps);
-        if (dir != motor->current_direction) {
-          motor->current_direction = dir;
-          tmc_set_dir(motor->device, dir);
-        }
+// Generate steps to target during [t_start, t_start + period) and queue them.
+static void queue_move_locked(motor_step_state_t* motor,
+                              float target,
+                              uint32_t t_start,
+                              uint32_t period) {
+  if (step_queue_full(&motor->queue)) {
+    return;  // steps will be generated by later move
+  }
+  if (step_queue_empty(&motor->queue)) {
+    step_gen_sync(&motor->gen, t_start);
+  }
+  step_run_t run;
+  if (!step_gen_move(&motor->gen, target, t_start, period, &run)) {
+    return;
+  }
+  step_queue_push(&motor->queue, &run);
+  arm_alarm_locked(run.first);
+}
 
-        // Start step pulse (HIGH)
-        tmc_set_step(motor->device, true);
-        motor->step_state = STEP_PULSE_HIGH;
-      } else {
-        // Motor is at target - handle idle timeout
-        if (!motor->always_energized) {
-          if (motor->idle_ticks < motor->idle_timeout_ticks) {
-            motor->idle_ticks++;
-          } else {
-            // De-energize after timeout
-            ensure_energized(motor, false);
-          }
+// Step ISR handler: executes steps that are due, and schedules next call at
+// the earliest next step.
+static void step_alarm_handler(const struct device* dev,
+                               uint8_t chan_id,
+                               uint32_t ticks,
+                               void* user_data) {
+  k_spinlock_key_t key = k_spin_lock(&step_lock);
+  alarm_armed = false;
+
+  uint32_t now = step_time_now();
+  motor_step_state_t* stepping[MOTOR_COUNT];
+  int num_stepping = 0;
+  bool dir_changed = false;
+  bool has_next = false;
+  uint32_t next = 0;
+  for (int i = 0; i < MOTOR_COUNT; i++) {
+    motor_step_state_t* motor = &motor_states[i];
+    const step_run_t* run = step_queue_peek(&motor->queue);
+    if (!run) {
+      continue;
+    }
+    if ((int32_t)(step_run_time(run, motor->run_steps) - now) <= 0) {
+      // Step is due - ensure energized
+      ensure_energized(motor, true);
+      if (run->dir != motor->current_direction) {
+        motor->current_direction = run->dir;
+        batch_set(&motor->dir_pin, run->dir);
+        dir_changed = true;
+      }
+      stepping[num_stepping++] = motor;
+      motor->current_steps += run->dir ? 1 : -1;
+
+      motor->run_steps++;
+      if (motor->run_steps == run->count) {
+        step_queue_pop(&motor->queue);
+        motor->run_steps = 0;
+        run = step_queue_peek(&motor->queue);
+        if (!run) {
+          motor->idle_since_ms = k_uptime_get_32();
+          continue;
         }
       }
-      break;
-
-    case STEP_PULSE_HIGH:
-      // End step pulse (LOW)
-      tmc_set_step(motor->device, false);
-      motor->step_state = STEP_PULSE_LOW;
+    }
+    uint32_t t = step_run_time(run, motor->run_steps);
+    if (!has_next || (int32_t)(t - next) < 0) {
+      next = t;
+      has_next = true;
+    }
+  }
 
-      // Update current position
-      if (motor->target_steps > motor->current_steps) {
-        motor->current_steps++;
-      } else {
-        motor->current_steps--;
-      }
-      break;
+  // Step pulse of all stepping motors. Dir is written before, not to change
+  // at the same time as step edge.
+  if (dir_changed) {
+    batch_flush();
+  }
+  if (num_stepping > 0) {
+    for (int i = 0; i < num_stepping; i++) {
+      batch_set(&stepping[i]->step_pin, true);
+    }
+    batch_flush();
+    k_busy_wait(STEP_PULSE_US);
+    for (int i = 0; i < num_stepping; i++) {
+      batch_set(&stepping[i]->step_pin, false);
+    }
+    batch_flush();
+  }
 
-    case STEP_PULSE_LOW:
-      // Wait one tick before allowing next step
-      motor->step_state = STEP_IDLE;
-      break;
+  if (has_next) {
+    arm_alarm_locked(next);
+  } else {
+    // All motors at target: park until next step is queued.
+    counter_stop(step_sched_cnt);
+    step_cnt_running = false;
   }
+  k_spin_unlock(&step_lock, key);
 }
 
-// Step generation ISR handler: manages step pulses (called every 30us)
-static void step_tick_handler(const struct device* dev, void* user_data) {
+// Idle timer handler: de-energizes motors idle longer than timeout
+static void idle_timer_handler(struct k_timer* timer) {
+  uint32_t now_ms = k_uptime_get_32();
+  k_spinlock_key_t key = k_spin_lock(&step_lock);
   for (int i = 0; i < MOTOR_COUNT; i++) {
-    process_motor_step(&motor_states[i]);
+    motor_step_state_t* motor = &motor_states[i];
+    if (motor->always_energized || !step_queue_empty(&motor->queue)) {
+      continue;
+    }
+    if (now_ms - motor->idle_since_ms >= motor->idle_timeout_ms) {
+      ensure_energized(motor, false);
+    }
   }
+  k_spin_unlock(&step_lock, key);
 }
 
 void queue_step(int motor_num, bool dir) {
@@ -120,14 +300,11 @@ void queue_step(int motor_num, bool dir) {
     return;  // Invalid motor number
   }
 
-  // Atomic increment/decrement of target
-  if (dir) {
-    __atomic_add_fetch(&motor_states[motor_num].target_steps, 1,
-                       __ATOMIC_SEQ_CST);
-  } else {
-    __atomic_sub_fetch(&motor_states[motor_num].target_steps, 1,
-                       __ATOMIC_SEQ_CST);
-  }
+  motor_step_state_t* motor = &motor_states[motor_num];
+  k_spinlock_key_t key = k_spin_lock(&step_lock);
+  float target = motor->gen.pos + (dir ? 1 : -1);
+  queue_move_locked(motor, target, step_time_now(), 0);
+  k_spin_unlock(&step_lock, key);
 }
 
 const struct device* motor_get_device(int motor_num) {
@@ -145,21 +322,58 @@ void motor_deenergize_after(int motor_num, int timeout_ms) {
   if (timeout_ms < 0) {
     // Negative value means always keep energized
     motor_states[motor_num].always_energized = true;
-    motor_states[motor_num].idle_timeout_ticks =
+    motor_states[motor_num].idle_timeout_ms =
         0;  // Unused when always_energized
   } else {
-    // Convert milliseconds to ISR ticks
     motor_states[motor_num].always_energized = false;
-    motor_states[motor_num].idle_timeout_ticks =
-        (timeout_ms * 1000) / STEP_ISR_PERIOD_US;
+    motor_states[motor_num].idle_timeout_ms = timeout_ms;
+  }
+}
+
+bool motor_is_held(int motor_num) {
+  if (motor_num < 0 || motor_num >= MOTOR_COUNT) {
+    return false;
   }
+  return motor_states[motor_num].energized &&
+         motor_states[motor_num].always_energized;
 }
 
 void motor_set_target_steps(int motor_num, int target_steps) {
   if (motor_num < 0 || motor_num >= MOTOR_COUNT) {
     return;  // Invalid motor number
   }
-  motor_states[motor_num].target_steps = target_steps;
+
+  motor_step_state_t* motor = &motor_states[motor_num];
+  k_spinlock_key_t key = k_spin_lock(&step_lock);
+  queue_move_locked(motor, target_steps, step_time_now(), 0);
+  k_spin_unlock(&step_lock, key);
+}
+
+void motor_move_targets(const int* motor_nums,
+                        const float* targets,
+                        int count,
+                        uint32_t period_us) {
+  uint32_t period = step_time_from_us(period_us);
+  k_spinlock_key_t key = k_spin_lock(&step_lock);
+  uint32_t now = step_time_now();
+  for (int i = 0; i < count; i++) {
+    int motor_num = motor_nums[i];
+    if (motor_num < 0 || motor_num >= MOTOR_COUNT) {
+      continue;  // Invalid motor number
+    }
+    motor_step_state_t* motor = &motor_states[motor_num];
+
+    // Steps are scheduled one period ahead, so that they're queued before
+    // due. Continue from the previous period when called periodically, to
+    // keep steps evenly spaced across periods.
+    int32_t ahead = (int32_t)(motor->move_time - now);
+    if (ahead < 0 || ahead > 2 * (int32_t)period) {
+      motor->move_time = now + period;
+    }
+    queue_move_locked(motor, targets[i], motor->move_time, period);
+    motor->move_time += period;
+  }
+  k_spin_unlock(&step_lock, key);
 }
 
 int motor_get_current_steps(int motor_num) {
@@ -226,18 +440,22 @@ void motor_run_steptest(int motor_num) {
 
 void motor_init() {
   // Initialize motor state arrays with default 200ms timeout
-  uint32_t default_timeout_ticks = (200 * 1000) / STEP_ISR_PERIOD_US;
   const struct device* motors[] = {motor0, motor1, motor2, motor3,
                                    motor4, motor5, motor6};
+  step_cnt_freq = counter_get_frequency(step_sched_cnt);
 
   for (int i = 0; i < MOTOR_COUNT; i++) {
     motor_states[i] =
-        (motor_step_state_t){.step_state = STEP_IDLE,
-                             .device = motors[i],
+        (motor_step_state_t){.device = motors[i],
                              .energized = false,
-                             .idle_ticks = 0,
-                             .idle_timeout_ticks = default_timeout_ticks,
+                             .idle_since_ms = 0,
+                             .idle_timeout_ms = 200,
                              .always_energized = false};
+    step_gen_init(&motor_states[i].gen, 0,
+                  step_time_from_us(STEP_MIN_INTERVAL_US));
+    step_queue_init(&motor_states[i].queue);
+    batch_pin_init(&motor_states[i].step_pin, &step_gpios[i]);
+    batch_pin_init(&motor_states[i].dir_pin, &dir_gpios[i]);
   }
 
   // Check motor devices
@@ -248,27 +466,24 @@ void motor_init() {
     }
   }
 
-  // Initialize step generation counter
-  struct counter_top_cfg step_top_cfg = {
-      .callback = step_tick_handler,
-      .ticks = counter_us_to_ticks(step_gen_cnt,
-                                   30),  // 30us ISR -> step pulse generation
-  };
-
-  counter_start(step_gen_cnt);
-  int ret = counter_set_top_value(step_gen_cnt, &step_top_cfg);
-  if (ret < 0) {
-    comm_print_err("motor: step gen timer init failed: %d", ret);
+  // Step scheduling counter is started when steps are queued.
+  if (!device_is_ready(step_sched_cnt)) {
+    comm_print_err("motor: step sched timer not ready");
     return;
   }
 
+  // Initialize timer for idle timeout
+  k_timer_init(&idle_timer, idle_timer_handler, NULL);
+  k_timer_start(&idle_timer, K_MSEC(IDLE_CHECK_PERIOD_MS),
+                K_MSEC(IDLE_CHECK_PERIOD_MS));
+
   // Configure TCOOLTHRS for all motors
   for (int i = 0; i < MOTOR_COUNT; i++) {
-    ret = tmc_set_tcoolthrs(motors[i], 750000);
+    int ret = tmc_set_tcoolthrs(motors[i], 750000);
     if (ret < 0) {
       comm_print_err("motor: failed to set TCOOLTHRS for mot%d", i);
     }
   }
 
-  comm_print("motor: init ok (30us tick)");
+  comm_print("motor: init ok (step queue)");
 }
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <zephyr/device.h>
 
 #define MOTOR_COUNT 7
@@ -15,18 +16,35 @@ void motor_init();
 
 /**
  * Queue a single step for specified motor for ASAP execution.
- * If different dir is enqueued faster than internal processing, they will be
- * canceled out before sent to hardware.
  */
 void queue_step(int motor_num, bool dir);
 
 /**
- * Set absolute target position for a specific motor (microsteps)
+ * Set absolute target position for a specific motor (microsteps).
+ * Motor moves to the target ASAP, at the max step rate.
  * @param motor_num Motor number (0-6)
  * @param target_steps Target position in microsteps
  */
 void motor_set_target_steps(int motor_num, int target_steps);
 
+/**
+ * Move multiple motors linearly to absolute targets (microsteps, can be
+ * fractional) over period_us. Intended to be called every period_us (e.g.
+ * motion tick).
+ *
+ * Each step is timed at the moment interpolated position crosses it, and
+ * executed one period after the call. So all motors of a call move in sync,
+ * with evenly spaced steps.
+ * @param motor_nums Motor numbers (0-6)
+ * @param targets Target positions in microsteps, for each of motor_nums
+ * @param count Number of motors
+ * @param period_us Duration of the move
+ */
+void motor_move_targets(const int* motor_nums,
+                        const float* targets,
+                        int count,
+                        uint32_t period_us);
+
 /**
  * Get current position for a specific motor (microsteps)
  * @param motor_num Motor number (0-6)
@@ -47,6 +65,9 @@ const struct device* motor_get_device(int motor_num);
  */
 void motor_deenergize_after(int motor_num, int timeout_ms);
 
+/** True if motor is energized, and will stay so when idle. */
+bool motor_is_held(int motor_num);
+
 /** (blocking) Dump motor subsystem status for debugging. */
 void motor_dump_status();
 
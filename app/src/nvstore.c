@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "nvstore.h"
+
+#include "comm.h"
+
+#include <errno.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/fs/zms.h>
+#include <zephyr/storage/flash_map.h>
+
+// ZMS (instead of NVS) because STM32H7 flash can't be programmed twice
+// without erase, which NVS requires.
+static struct zms_fs fs;
+static bool mounted = false;
+static uint32_t boot_count = 0;
+
+void nvstore_init() {
+  fs.flash_device = FIXED_PARTITION_DEVICE(storage_partition);
+  if (!device_is_ready(fs.flash_device)) {
+    comm_print_err("nvstore: flash not ready");
+    return;
+  }
+  fs.offset = FIXED_PARTITION_OFFSET(storage_partition);
+
+  struct flash_pages_info info;
+  int ret = flash_get_page_info_by_offs(fs.flash_device, fs.offset, &info);
+  if (ret < 0) {
+    comm_print_err("nvstore: page info failed: %d", ret);
+    return;
+  }
+  fs.sector_size = info.size;
+  fs.sector_count = FIXED_PARTITION_SIZE(storage_partition) / info.size;
+
+  ret = zms_mount(&fs);
+  if (ret < 0) {
+    comm_print_err("nvstore: mount failed: %d", ret);
+    return;
+  }
+  mounted = true;
+
+  uint32_t prev_count;
+  if (nvstore_read(NVSTORE_ID_BOOT_COUNT, &prev_count, sizeof(prev_count)) <
+      0) {
+    prev_count = 0;
+  }
+  boot_count = prev_count + 1;
+  nvstore_write(NVSTORE_ID_BOOT_COUNT, &boot_count, sizeof(boot_count));
+
+  comm_print("nvstore: init ok (boot %u)", boot_count);
+}
+
+uint32_t nvstore_get_boot_count() {
+  return boot_count;
+}
+
+int nvstore_read(uint32_t id, void* data, size_t len) {
+  if (!mounted) {
+    return -ENODEV;
+  }
+  ssize_t size = zms_get_data_length(&fs, id);
+  if (size < 0) {
+    return size;
+  }
+  if ((size_t)size != len) {
+    return -EINVAL;  // layout changed
+  }
+  ssize_t ret = zms_read(&fs, id, data, len);
+  return (ret < 0) ? ret : 0;
+}
+
+int nvstore_write(uint32_t id, const void* data, size_t len) {
+  if (!mounted) {
+    return -ENODEV;
+  }
+  ssize_t ret = zms_write(&fs, id, data, len);
+  return (ret < 0) ? ret : 0;
+}
+
+int nvstore_delete(uint32_t id) {
+  if (!mounted) {
+    return -ENODEV;
+  }
+  return zms_delete(&fs, id);
+}
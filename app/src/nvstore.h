@@ -0,0 +1,35 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+/**
+ * (Singleton) Non-volatile records on flash (storage_partition).
+ *
+ * Writing flash stalls the CPU (including ISRs), up to seconds when a sector
+ * needs erasing. Only write when motors are not moving.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Record IDs. Never reuse a removed ID for a different layout. */
+#define NVSTORE_ID_BOOT_COUNT 1
+#define NVSTORE_ID_HOME 2
+
+/** (blocking) Mount storage and count this boot. */
+void nvstore_init();
+
+/** Number of boots so far, including this one. 0 if storage is unavailable.
+ */
+uint32_t nvstore_get_boot_count();
+
+/**
+ * Read a record of exactly len bytes.
+ * @return 0 on success, negative error code if missing or size differs.
+ */
+int nvstore_read(uint32_t id, void* data, size_t len);
+
+/** (blocking) Write a record. Returns 0 on success, negative on error. */
+int nvstore_write(uint32_t id, const void* data, size_t len);
+
+/** (blocking) Delete a record. Returns 0 on success, negative on error. */
+int nvstore_delete(uint32_t id);
@@ -36,6 +36,7 @@ static const struct gpio_dt_spec gate_gpio =
 
 // Status tracking
 static bool init_success = false;
+static bool energized = false;
 static uint32_t poll_count = 0;
 
 // EDM state from latest poll
@@ -43,6 +44,22 @@ static uint8_t last_r_pulse = 0;
 static uint8_t last_r_short = 0;
 static uint8_t last_r_open = 0;
 static uint8_t last_n_pulse = 0;
+static uint8_t last_t_ign = 0;     // 5us units
+static uint8_t last_t_ign_sd = 0;  // 5us units
+// Total number of pulses since init (wraps around)
+static uint32_t pulse_count = 0;
+
+// Gap state estimated from the poll stream (config pushed from settings)
+static gap_est_t gap_est;
+static gap_cfg_t gap_cfg = {
+    .alpha = 0.2f,
+    .enter_rate = 0.6f,
+    .exit_rate = 0.4f,
+    .arc_pulse_us = 1500.0f,
+    .arc_polls = 5,
+};
+// Protects gap_est & gap_cfg between poll work and readers (incl. ISR).
+static struct k_spinlock gap_lock;
 
 // Ring buffer for EDM polling data
 #define EDM_BUFFER_SIZE 10000
@@ -106,10 +123,24 @@ static void edm_poll_work_handler(struct k_work* work) {
 
   // Update state from registers
   last_n_pulse = buf[REG_CKP_N_PULSE - REG_CKP_N_PULSE];
+  last_t_ign = buf[REG_T_IGNITION - REG_CKP_N_PULSE];
+  last_t_ign_sd = buf[REG_T_IGNITION_SD - REG_CKP_N_PULSE];
   last_r_pulse = buf[REG_R_PULSE - REG_CKP_N_PULSE];
   last_r_short = buf[REG_R_SHORT - REG_CKP_N_PULSE];
   last_r_open = buf[REG_R_OPEN - REG_CKP_N_PULSE];
   poll_count++;
+  pulse_count += last_n_pulse;
+
+  gap_poll_t poll = {
+      .n_pulse = last_n_pulse,
+      .r_pulse = last_r_pulse,
+      .r_short = last_r_short,
+      .r_open = last_r_open,
+      .t_ign_us = last_t_ign * 5.0f,
+  };
+  k_spinlock_key_t key = k_spin_lock(&gap_lock);
+  gap_est_update(&gap_est, &gap_cfg, &poll);
+  k_spin_unlock(&gap_lock, key);
 
   // Record (r_short, r_open, num_pulse) in ring buffer if not copying
   if (atomic_get(&copying_flag) == 0) {
@@ -152,6 +183,8 @@ void pulser_init() {
     return;
   }
 
+  gap_est_init(&gap_est);
+
   // Initialize work item
   k_work_init(&edm_poll_work, edm_poll_work_handler);
 
@@ -172,6 +205,12 @@ void pulser_dump_status() {
   comm_print("poll count: %u", poll_count);
   comm_print("EDM state: n_pulse=%u, r_pulse=%u, r_short=%u, r_open=%u",
              last_n_pulse, last_r_pulse, last_r_short, last_r_open);
+  comm_print("EDM ignition: avg=%uus, sd=%uus", last_t_ign * 5,
+             last_t_ign_sd * 5);
+  gap_est_t est = pulser_get_gap();
+  comm_print("EDM gap: %s, r_short=%.1f, r_open=%.1f, t_ign=%.1fus",
+             gap_state_name(est.state), (double)est.r_short,
+             (double)est.r_open, (double)est.t_ign_us);
   comm_print("EDM buffer: %u/%u entries (%.1f%% full)", edm_buffer_count,
              EDM_BUFFER_SIZE,
              (double)(edm_buffer_count * 100) / EDM_BUFFER_SIZE);
@@ -221,6 +260,7 @@ void pulser_energize(bool negative,
 
   // Enable gate
   set_gate(true);
+  energized = true;
   comm_print("pulser: energized (%s, %.0fµs, %.1fA, %.0f%%)",
              negative ? "T-" : "T+", (double)pulse_us, (double)current_a,
              (double)duty_pct);
@@ -233,6 +273,7 @@ void pulser_deenergize() {
 
   // Disable gate first
   set_gate(false);
+  energized = false;
 
   // Write polarity register to off
   bool ok = write_register(REG_POLARITY, 0);
@@ -244,6 +285,10 @@ void pulser_deenergize() {
   comm_print("pulser: deenergized");
 }
 
+bool pulser_is_energized() {
+  return energized;
+}
+
 uint32_t pulser_get_buffer_count() {
   return edm_buffer_count;
 }
@@ -286,6 +331,42 @@ uint8_t pulser_get_open_rate() {
   return last_r_open;
 }
 
+uint8_t pulser_get_num_pulse() {
+  return last_n_pulse;
+}
+
+uint32_t pulser_get_pulse_count() {
+  return pulse_count;
+}
+
+float pulser_get_ignition_us() {
+  return last_t_ign * 5.0f;
+}
+
+float pulser_get_ignition_sd_us() {
+  return last_t_ign_sd * 5.0f;
+}
+
+gap_est_t pulser_get_gap() {
+  k_spinlock_key_t key = k_spin_lock(&gap_lock);
+  gap_est_t est = gap_est;
+  k_spin_unlock(&gap_lock, key);
+  return est;
+}
+
+gap_cfg_t pulser_get_gap_cfg() {
+  k_spinlock_key_t key = k_spin_lock(&gap_lock);
+  gap_cfg_t cfg = gap_cfg;
+  k_spin_unlock(&gap_lock, key);
+  return cfg;
+}
+
+void pulser_set_gap_cfg(const gap_cfg_t* cfg) {
+  k_spinlock_key_t key = k_spin_lock(&gap_lock);
+  gap_cfg = *cfg;
+  k_spin_unlock(&gap_lock, key);
+}
+
 bool pulser_has_discharge() {
   return (last_r_pulse > 0 || last_r_short > 0);
 }
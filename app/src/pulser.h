@@ -5,6 +5,8 @@
  */
 #pragma once
 
+#include "gap_base.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -30,6 +32,9 @@ void pulser_energize(bool negative,
 /** (blocking)  De-energize pulser */
 void pulser_deenergize();
 
+/** Check if pulser gate is enabled by pulser_energize(). */
+bool pulser_is_energized();
+
 /**
  * Get latest short rate from EDM polling
  * @return short rate (0-255), typically >127 indicates retraction needed
@@ -42,6 +47,41 @@ uint8_t pulser_get_short_rate();
  */
 uint8_t pulser_get_open_rate();
 
+/**
+ * Get number of pulses in the latest EDM poll period
+ * @return number of pulses (0-255)
+ */
+uint8_t pulser_get_num_pulse();
+
+/**
+ * Get total number of pulses since init. Wraps around.
+ * Take difference of two calls to get pulses in between.
+ */
+uint32_t pulser_get_pulse_count();
+
+/**
+ * Get mean ignition delay (time from voltage applied to discharge) of pulses
+ * in the latest EDM poll period. Longer delay means wider gap.
+ * @return ignition delay in microseconds. Meaningless if there was no pulse.
+ */
+float pulser_get_ignition_us();
+
+/**
+ * Get standard deviation of ignition delay in the latest EDM poll period
+ * @return standard deviation in microseconds
+ */
+float pulser_get_ignition_sd_us();
+
+/**
+ * Get gap state estimated from the poll stream (smoothed, with hysteresis).
+ * Safe to call from ISR.
+ */
+gap_est_t pulser_get_gap();
+
+/** Get / set gap estimator config. Applied from the next poll. */
+gap_cfg_t pulser_get_gap_cfg();
+void pulser_set_gap_cfg(const gap_cfg_t* cfg);
+
 /**
  * Check if there is active discharge (pulse or short)
  * @return true if r_pulse > 0 or r_short > 0
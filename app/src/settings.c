@@ -2,8 +2,10 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 #include "settings.h"
 
+#include "gcode.h"
 #include "motion.h"
 #include "motor.h"
+#include "pulser.h"
 #include "strutil.h"
 #include "wirefeed.h"
 
@@ -18,15 +20,66 @@ typedef struct {
   float value;
 } setting_entry_t;
 
-// Settings array with all 3 motors and axes (sorted by key)
+// Settings array with all motors and axes (sorted by key)
 static setting_entry_t settings[] = {
     // Axis settings
+    {"a.a.maxacc", 10.0f},
+    {"a.a.maxvel", 1.0f},
+    {"a.b.maxacc", 10.0f},
+    {"a.b.maxvel", 1.0f},
+    {"a.c.maxacc", 10.0f},
+    {"a.c.maxvel", 1.0f},
+    {"a.x.backoff", 1.0f},
+    {"a.x.maxacc", 300.0f},
+    {"a.x.maxvel", 30.0f},
     {"a.x.origin", 0.0f},
+    {"a.x.phase", 1.0f},
+    {"a.x.seekvel", 10.0f},
     {"a.x.side", 1.0f},
+    {"a.x.touchvel", 1.0f},
+    {"a.y.backoff", 1.0f},
+    {"a.y.maxacc", 300.0f},
+    {"a.y.maxvel", 30.0f},
     {"a.y.origin", 0.0f},
+    {"a.y.phase", 1.0f},
+    {"a.y.seekvel", 10.0f},
     {"a.y.side", -1.0f},
+    {"a.y.touchvel", 1.0f},
+    {"a.z.backoff", 1.0f},
+    {"a.z.maxacc", 300.0f},
+    {"a.z.maxvel", 30.0f},
     {"a.z.origin", 0.0f},
+    {"a.z.phase", 0.0f},
+    {"a.z.seekvel", 10.0f},
     {"a.z.side", 1.0f},
+    {"a.z.touchvel", 1.0f},
+    // EDM settings
+    {"e.esc.amp", 0.05f},
+    {"e.esc.enable", 0.0f},
+    {"e.esc.gain", 0.02f},
+    {"e.esc.max", 0.5f},
+    {"e.esc.min", -0.5f},
+    {"e.esc.period", 0.5f},
+    {"e.gap.arcn", 5.0f},
+    {"e.gap.arcus", 1500.0f},
+    {"e.gap.enter", 0.6f},
+    {"e.gap.exit", 0.4f},
+    {"e.gap.filter", 0.2f},
+    {"e.notch", 0.005f},
+    {"e.retract", 1.0f},
+    {"e.servo.ignus", 50.0f},
+    {"e.servo.kd", 0.0f},
+    {"e.servo.ki", 0.0f},
+    {"e.servo.kp", 2.0f},
+    {"e.servo.maxacc", 1000.0f},
+    {"e.servo.maxvel", 1.0f},
+    {"e.servo.readvance", 10.0f},
+    {"e.servo.retvel", 5.0f},
+    {"e.servo.setpoint", 0.0f},
+    {"e.servo.slowzone", 0.05f},
+    {"e.servo.source", 0.0f},
+    // G-code settings
+    {"g.arctol", 0.002f},
     // Motor settings
     {"m.0.current", 30.0f},
     {"m.0.idlems", 200.0f},
@@ -136,21 +189,57 @@ static bool apply_axis(char* mut_key, float value) {
   }
 
   // Get axis number from name
+  static const char* axis_names[AXIS_COUNT] = {"x", "y", "z", "a", "b", "c"};
   int axis_num = -1;
-  if (strcmp(mut_key, "x") == 0) {
-    axis_num = 0;
-  } else if (strcmp(mut_key, "y") == 0) {
-    axis_num = 1;
-  } else if (strcmp(mut_key, "z") == 0) {
-    axis_num = 2;
-  } else {
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    if (strcmp(mut_key, axis_names[i]) == 0) {
+      axis_num = i;
+    }
+  }
+  if (axis_num < 0) {
     return false;  // Invalid axis name
   }
 
   // Apply setting
-  if (strcmp(rest, "origin") == 0) {
+  if (strcmp(rest, "maxvel") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    motion_set_axis_max_vel(axis_num, value);
+    return true;
+  } else if (strcmp(rest, "maxacc") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    motion_set_axis_max_acc(axis_num, value);
+    return true;
+  } else if (strcmp(rest, "seekvel") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    motion_set_home_seek_vel(axis_num, value);
+    return true;
+  } else if (strcmp(rest, "backoff") == 0) {
+    if (value < 0) {
+      return false;
+    }
+    motion_set_home_backoff(axis_num, value);
+    return true;
+  } else if (strcmp(rest, "touchvel") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    motion_set_home_touch_vel(axis_num, value);
+    return true;
+  } else if (strcmp(rest, "origin") == 0) {
     motion_set_home_origin(axis_num, value);
     return true;
+  } else if (strcmp(rest, "phase") == 0) {
+    if (value < 0 || value > MOTION_MAX_HOME_PHASE || value != (int)value) {
+      return false;
+    }
+    motion_set_home_phase(axis_num, (int)value);
+    return true;
   } else if (strcmp(rest, "side") == 0) {
     motion_set_home_side(axis_num, value);
     return true;
@@ -159,6 +248,188 @@ static bool apply_axis(char* mut_key, float value) {
   return false;
 }
 
+// EDM servo setting application under "e.servo."
+static bool apply_edm_servo(char* mut_key, float value) {
+  edm_servo_cfg_t cfg = motion_get_edm_servo();
+  if (strcmp(mut_key, "source") == 0) {
+    if (value != EDM_FEEDBACK_RATE && value != EDM_FEEDBACK_IGNITION) {
+      return false;
+    }
+    cfg.feedback = (edm_feedback_t)value;
+  } else if (strcmp(mut_key, "ignus") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    cfg.ign_ref_us = value;
+  } else if (strcmp(mut_key, "setpoint") == 0) {
+    if (value < -1 || value > 1) {
+      return false;
+    }
+    cfg.setpoint = value;
+  } else if (strcmp(mut_key, "kp") == 0) {
+    if (value < 0) {
+      return false;
+    }
+    cfg.kp = value;
+  } else if (strcmp(mut_key, "ki") == 0) {
+    if (value < 0) {
+      return false;
+    }
+    cfg.ki = value;
+  } else if (strcmp(mut_key, "kd") == 0) {
+    if (value < 0) {
+      return false;
+    }
+    cfg.kd = value;
+  } else if (strcmp(mut_key, "maxvel") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    cfg.max_vel = value;
+  } else if (strcmp(mut_key, "retvel") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    cfg.max_retract_vel = value;
+  } else if (strcmp(mut_key, "maxacc") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    cfg.max_acc = value;
+  } else if (strcmp(mut_key, "readvance") == 0) {
+    if (value < 0) {
+      return false;
+    }
+    cfg.readvance_vel = value;
+  } else if (strcmp(mut_key, "slowzone") == 0) {
+    if (value < 0) {
+      return false;
+    }
+    cfg.slow_zone_mm = value;
+  } else {
+    return false;
+  }
+  motion_set_edm_servo(&cfg);
+  return true;
+}
+
+// Gap estimator setting application under "e.gap."
+static bool apply_edm_gap(char* mut_key, float value) {
+  gap_cfg_t cfg = pulser_get_gap_cfg();
+  if (strcmp(mut_key, "filter") == 0) {
+    if (value <= 0 || value > 1) {
+      return false;
+    }
+    cfg.alpha = value;
+  } else if (strcmp(mut_key, "enter") == 0) {
+    if (value < cfg.exit_rate || value > 1) {
+      return false;
+    }
+    cfg.enter_rate = value;
+  } else if (strcmp(mut_key, "exit") == 0) {
+    if (value < 0 || value > cfg.enter_rate) {
+      return false;
+    }
+    cfg.exit_rate = value;
+  } else if (strcmp(mut_key, "arcus") == 0) {
+    if (value <= 0) {
+      return false;
+    }
+    cfg.arc_pulse_us = value;
+  } else if (strcmp(mut_key, "arcn") == 0) {
+    if (value < 1 || value > 1000) {
+      return false;
+    }
+    cfg.arc_polls = (int)value;
+  } else {
+    return false;
+  }
+  pulser_set_gap_cfg(&cfg);
+  return true;
+}
+
+// Setpoint tuning setting application under "e.esc."
+static bool apply_edm_esc(char* mut_key, float value) {
+  edm_esc_cfg_t cfg = motion_get_edm_esc();
+  if (strcmp(mut_key, "enable") == 0) {
+    if (value != 0 && value != 1) {
+      return false;
+    }
+    cfg.enabled = value == 1;
+  } else if (strcmp(mut_key, "amp") == 0) {
+    if (value <= 0 || value > 0.5f) {
+      return false;
+    }
+    cfg.amplitude = value;
+  } else if (strcmp(mut_key, "period") == 0) {
+    if (value < 0.01f) {
+      return false;
+    }
+    cfg.period_s = value;
+  } else if (strcmp(mut_key, "gain") == 0) {
+    if (value < 0 || value > 1) {
+      return false;
+    }
+    cfg.gain = value;
+  } else if (strcmp(mut_key, "min") == 0) {
+    if (value < -1 || value > cfg.max_base) {
+      return false;
+    }
+    cfg.min_base = value;
+  } else if (strcmp(mut_key, "max") == 0) {
+    if (value < cfg.min_base || value > 1) {
+      return false;
+    }
+    cfg.max_base = value;
+  } else {
+    return false;
+  }
+  motion_set_edm_esc(&cfg);
+  return true;
+}
+
+// EDM setting application under "e."
+static bool apply_edm(char* mut_key, float value) {
+  char* rest = split_at(mut_key, '.');
+  if (rest) {
+    if (strcmp(mut_key, "servo") == 0) {
+      return apply_edm_servo(rest, value);
+    } else if (strcmp(mut_key, "gap") == 0) {
+      return apply_edm_gap(rest, value);
+    } else if (strcmp(mut_key, "esc") == 0) {
+      return apply_edm_esc(rest, value);
+    }
+    return false;
+  }
+
+  if (strcmp(mut_key, "notch") == 0) {
+    if (value < 0.001f || value > 0.05f) {
+      return false;
+    }
+    motion_set_edm_notch(value);
+    return true;
+  } else if (strcmp(mut_key, "retract") == 0) {
+    if (value < 0) {
+      return false;
+    }
+    motion_set_edm_retract(value);
+    return true;
+  }
+  return false;
+}
+
+// G-code setting application under "g."
+static bool apply_gcode(char* mut_key, float value) {
+  if (strcmp(mut_key, "arctol") == 0) {
+    if (value < 0.0001f) {
+      return false;
+    }
+    gcode_set_arc_tol(value);
+    return true;
+  }
+  return false;
+}
+
 // Hierarchical apply dispatcher
 static bool apply_setting(const char* key, float value) {
   // Make mutable copy for parsing
@@ -176,6 +447,10 @@ static bool apply_setting(const char* key, float value) {
     return apply_motor(rest, value);
   } else if (strcmp(mut_key, "a") == 0) {
     return apply_axis(rest, value);
+  } else if (strcmp(mut_key, "e") == 0) {
+    return apply_edm(rest, value);
+  } else if (strcmp(mut_key, "g") == 0) {
+    return apply_gcode(rest, value);
   }
   return false;
 }
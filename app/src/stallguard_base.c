@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "stallguard_base.h"
+
+void sg_sweep_init(sg_sweep_t* sw) {
+  sw->thresh = 0;
+  sw->clean_thresh = -1;
+  sw->sg_min = -1;
+}
+
+bool sg_sweep_update(sg_sweep_t* sw, int sg_result, bool stalled) {
+  if (sg_result < 0) {
+    return true;  // retry same threshold
+  }
+  if (stalled) {
+    return false;  // false stall: thresh is too sensitive
+  }
+
+  if (sw->sg_min < 0 || sg_result < sw->sg_min) {
+    sw->sg_min = sg_result;
+  }
+  sw->clean_thresh = sw->thresh;
+  sw->thresh += SG_SWEEP_STEP;
+  return sw->thresh <= SG_THRESH_MAX;
+}
+
+int sg_sweep_result(const sg_sweep_t* sw, float margin) {
+  if (sw->clean_thresh < 0) {
+    return -1;
+  }
+
+  // Threshold that would trigger at the lowest load seen while running.
+  int limit = sw->sg_min / 2;
+  if (sw->clean_thresh < limit) {
+    limit = sw->clean_thresh;
+  }
+  return (int)(limit * margin);
+}
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+/**
+ * (Stateless) StallGuard threshold calibration logic.
+ * No side effects, no global state - easily testable.
+ *
+ * TMC2209 reports stall when SG_RESULT < 2 * SGTHRS. Higher threshold detects
+ * stall with less load (more sensitive), but too high threshold reports stall
+ * even while running freely.
+ *
+ * Calibration runs the motor freely at homing speed, while sweeping threshold
+ * upwards from 0. The sweep ends at the first (false) stall.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+// Max value of SGTHRS register.
+#define SG_THRESH_MAX 255
+
+// Threshold increment per sample.
+#define SG_SWEEP_STEP 4
+
+// Max number of samples in a sweep.
+#define SG_SWEEP_MAX_SAMPLES (SG_THRESH_MAX / SG_SWEEP_STEP + 1)
+
+typedef struct {
+  int thresh;        // threshold to apply for the next sample
+  int clean_thresh;  // highest threshold without stall (-1: none)
+  int sg_min;        // min SG_RESULT seen (-1: no sample)
+} sg_sweep_t;
+
+void sg_sweep_init(sg_sweep_t* sw);
+
+/**
+ * Record a sample taken while sw->thresh was applied, and advance threshold.
+ * Negative sg_result (read error) is ignored.
+ *
+ * @return true if more samples are needed.
+ */
+bool sg_sweep_update(sg_sweep_t* sw, int sg_result, bool stalled);
+
+/**
+ * Pick the most sensitive threshold that didn't stall during the sweep and is
+ * consistent with observed SG_RESULT, scaled down by margin (0~1).
+ *
+ * @return threshold, or -1 if the sweep has no clean sample.
+ */
+int sg_sweep_result(const sg_sweep_t* sw, float margin);
@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "step_base.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+uint32_t step_run_time(const step_run_t* run, int k) {
+  return run->first + run->interval * (uint32_t)k;
+}
+
+void step_queue_init(step_queue_t* q) {
+  q->head = 0;
+  q->tail = 0;
+}
+
+bool step_queue_push(step_queue_t* q, const step_run_t* run) {
+  uint32_t head = q->head;
+  uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= STEP_QUEUE_SIZE) {
+    return false;
+  }
+  q->runs[head % STEP_QUEUE_SIZE] = *run;
+  // Publish the run after it's written.
+  __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+const step_run_t* step_queue_peek(const step_queue_t* q) {
+  uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+  if (head == q->tail) {
+    return NULL;
+  }
+  return &q->runs[q->tail % STEP_QUEUE_SIZE];
+}
+
+void step_queue_pop(step_queue_t* q) {
+  __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+}
+
+bool step_queue_empty(const step_queue_t* q) {
+  return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) ==
+         __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
+
+bool step_queue_full(const step_queue_t* q) {
+  return q->head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >=
+         STEP_QUEUE_SIZE;
+}
+
+void step_gen_init(step_gen_t* gen, int pos, uint32_t min_interval) {
+  gen->target = pos;
+  gen->pos = pos;
+  gen->last_step = 0;
+  gen->min_interval = min_interval;
+}
+
+void step_gen_sync(step_gen_t* gen, uint32_t time) {
+  gen->last_step = time - gen->min_interval;
+}
+
+bool step_gen_move(step_gen_t* gen,
+                   float target,
+                   uint32_t t_start,
+                   uint32_t period,
+                   step_run_t* run) {
+  float prev_target = gen->target;
+  gen->target = target;
+
+  int n = (int)floorf(target + 0.5f) - gen->pos;
+  if (n == 0) {
+    return false;
+  }
+  bool dir = n > 0;
+  int count = abs(n);
+  if (count > UINT16_MAX) {
+    count = UINT16_MAX;  // rest will be generated by next move
+  }
+
+  // Find when position crosses the midpoints, as fraction of period.
+  // Midpoints are 1 microstep apart, so crossings are evenly spaced.
+  float span = fabsf(target - prev_target);
+  float frac_first = 0;
+  float frac_interval = 0;
+  if (span > 0) {
+    float dist_first = dir ? (gen->pos + 0.5f - prev_target)
+                           : (prev_target - (gen->pos - 0.5f));
+    frac_first = fminf(fmaxf(dist_first / span, 0), 1);
+    frac_interval = 1 / span;
+  }
+
+  uint32_t first = t_start + (uint32_t)lroundf(frac_first * period);
+  uint32_t earliest = gen->last_step + gen->min_interval;
+  if ((int32_t)(first - earliest) < 0) {
+    first = earliest;
+  }
+  uint32_t interval = (uint32_t)lroundf(frac_interval * period);
+  if (interval < gen->min_interval) {
+    interval = gen->min_interval;
+  }
+
+  *run = (step_run_t){
+      .first = first, .interval = interval, .count = count, .dir = dir};
+  gen->pos += dir ? count : -count;
+  gen->last_step = step_run_time(run, count - 1);
+  return true;
+}
@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+/**
+ * (Stateless) Step timing computation utilities and data structures.
+ * No side effects, no global state - easily testable.
+ *
+ * Steps of a motor are described by a queue of "runs": evenly spaced steps in
+ * one direction. Producer (motion tick) appends runs ahead of time, and step
+ * generation ISR executes each step at its time.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Step times are in fixed-point ticks of the step timer with this many
+// fractional bits, so that evenly spaced steps don't accumulate rounding
+// errors. Times are absolute, and wrap around (compare them by signed
+// difference).
+#define STEP_TIME_FRAC_BITS 4
+
+// Number of runs that can be queued per motor. Producer is at most a couple
+// of motion ticks ahead of step generation, and writes one run per tick.
+// Must be power of 2.
+#define STEP_QUEUE_SIZE 16
+
+/** Convert timer ticks to step time. */
+#define STEP_TIME_TICKS(ticks) ((uint32_t)(ticks) << STEP_TIME_FRAC_BITS)
+
+/** Evenly spaced steps in one direction. */
+typedef struct {
+  uint32_t first;     // time of the first step
+  uint32_t interval;  // time between steps
+  uint16_t count;     // number of steps (>= 1)
+  bool dir;           // true: +1 step each, false: -1 step each
+} step_run_t;
+
+/** Time of k-th (0-based) step of run. */
+uint32_t step_run_time(const step_run_t* run, int k);
+
+/**
+ * Single-producer single-consumer queue of runs.
+ * Safe to use from two contexts (e.g. two ISRs) without locking.
+ */
+typedef struct {
+  step_run_t runs[STEP_QUEUE_SIZE];
+  uint32_t head;  // written only by producer
+  uint32_t tail;  // written only by consumer
+} step_queue_t;
+
+void step_queue_init(step_queue_t* q);
+
+/** (producer) Append run. Returns false if queue is full. */
+bool step_queue_push(step_queue_t* q, const step_run_t* run);
+
+/** (consumer) Get the oldest run, or NULL if queue is empty. */
+const step_run_t* step_queue_peek(const step_queue_t* q);
+
+/** (consumer) Remove the oldest run. Call only after all steps are done. */
+void step_queue_pop(step_queue_t* q);
+
+/** True if all queued runs are done. */
+bool step_queue_empty(const step_queue_t* q);
+
+/** True if no more run can be pushed. */
+bool step_queue_full(const step_queue_t* q);
+
+/** Generates step runs of a motor from its target positions over time. */
+typedef struct {
+  float target;           // latest target (microsteps)
+  int pos;                // position after all generated steps (microsteps)
+  uint32_t last_step;     // time of the last generated step
+  uint32_t min_interval;  // min time between steps
+} step_gen_t;
+
+void step_gen_init(step_gen_t* gen, int pos, uint32_t min_interval);
+
+/**
+ * Forget generated steps before time. Call when all generated steps are done,
+ * so that stale last_step (which can wrap around) doesn't delay new steps.
+ */
+void step_gen_sync(step_gen_t* gen, uint32_t time);
+
+/**
+ * Move linearly from current target to new target during
+ * [t_start, t_start + period). Step happens when the position crosses a
+ * midpoint between microsteps (i.e. motor is at round(position)).
+ * Steps are delayed to keep min_interval, if target moves too fast.
+ *
+ * @param period 0 means "as soon as possible", starting from t_start.
+ * @return true if run is generated. false if no step is needed.
+ */
+bool step_gen_move(step_gen_t* gen,
+                   float target,
+                   uint32_t t_start,
+                   uint32_t period,
+                   step_run_t* run);
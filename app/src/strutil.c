@@ -100,3 +100,25 @@ bool parse_float(const char* str, float* value) {
   *value = result;
   return true;
 }
+
+bool parse_stream_line(char* line, int* seq, char** cmd) {
+  if (line[0] != ':') {
+    return false;
+  }
+  *cmd = NULL;
+  if (strcmp(line, "::") == 0) {
+    *seq = 0;
+    return true;
+  }
+
+  char* num = line + 1;
+  char* rest = split_at(num, ' ');
+  int value;
+  if (!rest || rest[0] == '\0' || !parse_int(num, &value) || value < 1) {
+    *seq = -1;
+    return true;
+  }
+  *seq = value;
+  *cmd = rest;
+  return true;
+}
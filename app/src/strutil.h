@@ -59,3 +59,20 @@ bool parse_int(const char* str, int* value);
  * @return true if valid float, false otherwise
  */
 bool parse_float(const char* str, float* value);
+
+/**
+ * Destructively parses stream line (":" seq " " command, or "::").
+ *
+ * @param line line to parse
+ * @param seq output sequence number. 0 for "::" (end of stream), -1 if the
+ * line is malformed.
+ * @param cmd output command (NULL unless seq > 0)
+ * @return false if line is not a stream line (doesn't start with ':').
+ *
+ * Examples:
+ *   ":12 G1 X1" -> seq=12, cmd="G1 X1"
+ *   "::" -> seq=0, cmd=NULL
+ *   ":x G1" -> seq=-1, cmd=NULL
+ *   "G1 X1" -> false
+ */
+bool parse_stream_line(char* line, int* seq, char** cmd);
@@ -12,7 +12,6 @@ typedef enum {
   STATE_IDLE,  // Machine is not executing command, ready to accept commands
   STATE_EXEC_INTERACTIVE,  // Machine is executing a single isolated command
   STATE_EXEC_STREAM  // Machine is executing a sequence of streamed commands
-                     // (future)
 } machine_state_t;
 
 /** Global state (will be properly encapsulated later) */
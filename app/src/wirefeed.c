@@ -57,6 +57,10 @@ void wirefeed_stop() {
   state = WIREFEED_STATE_STOPPED;
 }
 
+bool wirefeed_is_feeding() {
+  return state == WIREFEED_STATE_FEEDING;
+}
+
 void wirefeed_set_unitsteps(float unitsteps) {
   motor_unitsteps = unitsteps;
 }
@@ -5,6 +5,8 @@
  */
 #pragma once
 
+#include <stdbool.h>
+
 /**
  * (blocking) Initialize wirefeed subsystem.
  */
@@ -21,6 +23,11 @@ void wirefeed_start(float feedrate_mm_per_min);
  */
 void wirefeed_stop();
 
+/**
+ * Check if wire is being fed.
+ */
+bool wirefeed_is_feeding();
+
 /**
  * Set motor6 unitsteps.
  * @param unitsteps Steps per mm for motor6
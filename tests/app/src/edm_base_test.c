@@ -0,0 +1,320 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "edm_base.h"
+
+#include <math.h>
+#include <zephyr/ztest.h>
+
+#define DT 0.001f
+
+static const edm_servo_cfg_t CFG = {
+    .setpoint = 0,
+    .kp = 2.0f,
+    .ki = 0,
+    .kd = 0,
+    .max_vel = 1.0f,
+    .max_retract_vel = 5.0f,
+    .max_acc = 1000.0f,
+};
+
+ZTEST(edm_base, test_edm_gap_signal) {
+  zassert_within(edm_gap_signal(255, 0), 1.0f, 1e-6f, "All open");
+  zassert_within(edm_gap_signal(0, 255), -1.0f, 1e-6f, "All short");
+  zassert_within(edm_gap_signal(100, 100), 0.0f, 1e-6f, "Balanced");
+}
+
+ZTEST(edm_base, test_edm_ignition_signal) {
+  zassert_within(edm_ignition_signal(50, 50), 0.0f, 1e-6f, "At reference");
+  zassert_within(edm_ignition_signal(75, 50), 0.5f, 1e-6f, "Wider gap");
+  zassert_within(edm_ignition_signal(0, 50), -1.0f, 1e-6f, "Immediate");
+  zassert_within(edm_ignition_signal(500, 50), 1.0f, 1e-6f, "Clamped");
+}
+
+ZTEST(edm_base, test_edm_feedback_signal) {
+  edm_servo_cfg_t cfg = CFG;
+  cfg.ign_ref_us = 50;
+  gap_est_t est;
+  gap_est_init(&est);
+  est.r_open = 51;
+  est.r_short = 0;
+
+  cfg.feedback = EDM_FEEDBACK_IGNITION;
+  zassert_within(edm_feedback_signal(&cfg, &est), 0.2f, 1e-6f,
+                 "No pulse yet: falls back to rate");
+
+  est.t_ign_us = 75;
+  est.has_ign = true;
+  zassert_within(edm_feedback_signal(&cfg, &est), 0.5f, 1e-6f,
+                 "Ignition source");
+  cfg.feedback = EDM_FEEDBACK_RATE;
+  zassert_within(edm_feedback_signal(&cfg, &est), 0.2f, 1e-6f,
+                 "Rate source ignores ignition delay");
+
+  est.state = GAP_OPEN;
+  zassert_equal(edm_feedback_signal(&cfg, &est), 1.0f, "Open: advance");
+  est.state = GAP_SHORT;
+  zassert_equal(edm_feedback_signal(&cfg, &est), -1.0f, "Short: retract");
+  est.state = GAP_ARC;
+  zassert_equal(edm_feedback_signal(&cfg, &est), -1.0f, "Arc: retract");
+}
+
+ZTEST(edm_base, test_edm_servo_proportional) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 0);
+
+  // err 0.25 -> 0.5 mm/s, reachable within acc limit (1 mm/s per tick).
+  float d = edm_servo_step(&sv, &CFG, 0.25f, true, DT);
+  zassert_within(sv.vel, 0.5f, 1e-6f, "P output");
+  zassert_within(d, 0.25f * DT, 1e-9f, "Ramps from 0 to 0.5 mm/s");
+
+  // At setpoint: stops.
+  edm_servo_step(&sv, &CFG, 0, true, DT);
+  zassert_within(sv.vel, 0.0f, 1e-6f, "Stops at setpoint");
+}
+
+ZTEST(edm_base, test_edm_servo_vel_limits) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 0);
+
+  for (int i = 0; i < 100; i++) {
+    edm_servo_step(&sv, &CFG, 1.0f, true, DT);
+  }
+  zassert_within(sv.vel, 1.0f, 1e-6f, "Advance limited by max_vel");
+
+  for (int i = 0; i < 100; i++) {
+    edm_servo_step(&sv, &CFG, -1.0f, true, DT);
+  }
+  zassert_within(sv.vel, -2.0f, 1e-6f, "P output within retract limit");
+
+  edm_servo_cfg_t cfg = CFG;
+  cfg.kp = 100.0f;
+  for (int i = 0; i < 100; i++) {
+    edm_servo_step(&sv, &cfg, -1.0f, true, DT);
+  }
+  zassert_within(sv.vel, -5.0f, 1e-6f, "Retract limited");
+}
+
+ZTEST(edm_base, test_edm_servo_acc_limit) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 1.0f);
+  edm_servo_cfg_t cfg = CFG;
+  cfg.max_acc = 100.0f;
+
+  // Full short: wants -2 mm/s, but can change only 0.1 mm/s per tick.
+  edm_servo_step(&sv, &cfg, -1.0f, true, DT);
+  zassert_within(sv.vel, 0.9f, 1e-6f, "Decelerate by max_acc");
+  for (int i = 0; i < 29; i++) {
+    edm_servo_step(&sv, &cfg, -1.0f, true, DT);
+  }
+  zassert_within(sv.vel, -2.0f, 1e-5f, "Reaches target after 30 ticks");
+}
+
+ZTEST(edm_base, test_edm_servo_integral) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 0);
+  edm_servo_cfg_t cfg = CFG;
+  cfg.kp = 0;
+  cfg.ki = 10.0f;
+
+  // Constant err 0.05 for 1 s -> 0.5 mm/s.
+  for (int i = 0; i < 1000; i++) {
+    edm_servo_step(&sv, &cfg, 0.05f, true, DT);
+  }
+  zassert_within(sv.vel, 0.5f, 1e-3f, "Integral builds up");
+
+  // Saturated for long time: integral must not wind up.
+  for (int i = 0; i < 10000; i++) {
+    edm_servo_step(&sv, &cfg, 1.0f, true, DT);
+  }
+  zassert_within(sv.vel, 1.0f, 1e-6f, "Saturated");
+  for (int i = 0; i < 200; i++) {
+    edm_servo_step(&sv, &cfg, -1.0f, true, DT);
+  }
+  zassert_true(sv.vel < 0, "Reverses quickly without windup");
+}
+
+ZTEST(edm_base, test_edm_servo_setpoint) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 0);
+  edm_servo_cfg_t cfg = CFG;
+  cfg.setpoint = 0.2f;
+
+  edm_servo_step(&sv, &cfg, 0.2f, true, DT);
+  zassert_within(sv.vel, 0.0f, 1e-6f, "Holds at setpoint");
+  edm_servo_step(&sv, &cfg, 0.0f, true, DT);
+  zassert_true(sv.vel < 0, "Narrower than setpoint: retract");
+}
+
+ZTEST(edm_base, test_edm_servo_derivative) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 0);
+  edm_servo_cfg_t cfg = CFG;
+  cfg.kp = 0;
+  cfg.kd = 0.01f;
+
+  // Gap widens by 0.005 per poll (1ms, every 5 steps): 5/s.
+  float gap = 0;
+  for (int i = 0; i < 50; i++) {
+    bool new_poll = i % 5 == 0;
+    if (new_poll) {
+      gap += 0.005f;
+    }
+    edm_servo_step(&sv, &cfg, gap, new_poll, DT / 5);
+    if (i >= 5) {
+      zassert_within(sv.vel, 0.05f, 1e-5f, "Steady D output at step %d", i);
+    }
+  }
+
+  // Setpoint change alone doesn't kick.
+  cfg.setpoint = 0.5f;
+  edm_servo_step(&sv, &cfg, gap, true, DT / 5);
+  zassert_within(sv.vel, 0.0f, 1e-5f, "No kick by setpoint");
+}
+
+ZTEST(edm_base, test_edm_servo_readvance_disabled) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 0);
+  zassert_equal(edm_servo_readvance(&sv, &CFG, 1.0f, 0.001f, DT), 0.001f,
+                "Disabled: servo distance as is");
+}
+
+ZTEST(edm_base, test_edm_servo_readvance) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 0);
+  edm_servo_cfg_t cfg = CFG;
+  cfg.readvance_vel = 10.0f;
+  cfg.slow_zone_mm = 0.05f;
+  float d_servo = 0.5f * DT;
+
+  zassert_equal(edm_servo_readvance(&sv, &cfg, 1.0f, -d_servo, DT), -d_servo,
+                "Retracting: unchanged");
+  zassert_equal(edm_servo_readvance(&sv, &cfg, 0.04f, d_servo, DT), d_servo,
+                "Within slow zone: servo speed");
+
+  // Re-advance 1mm of retraction.
+  float retract = 1.0f;
+  int ticks = 0;
+  float v_peak = 0;
+  while (retract > cfg.slow_zone_mm + 1e-6f) {
+    float d = edm_servo_readvance(&sv, &cfg, retract, d_servo, DT);
+    zassert_true(d >= d_servo, "Never slower than servo");
+    zassert_true(d <= retract - cfg.slow_zone_mm + 1e-6f || d == d_servo,
+                 "Doesn't overshoot slow zone");
+    v_peak = fmaxf(v_peak, d / DT);
+    retract -= d;
+    ticks++;
+    zassert_true(ticks < 1000, "Should reach slow zone");
+  }
+  zassert_within(v_peak, 10.0f, 1e-3f, "Reaches re-advance velocity");
+  zassert_true(ticks < 200, "Much faster than servo (1900 ticks)");
+  zassert_true(sv.readvance_vel < 3.0f, "Slowed down at slow zone");
+}
+
+ZTEST(edm_base, test_edm_servo_readvance_short) {
+  edm_servo_t sv;
+  edm_servo_init(&sv, 0);
+  edm_servo_cfg_t cfg = CFG;
+  cfg.readvance_vel = 10.0f;
+  cfg.slow_zone_mm = 0.05f;
+
+  // Re-advance at full speed from 1mm of retraction.
+  float retract = 1.0f;
+  float v_prev = 0;
+  for (int i = 0; i < 20; i++) {
+    float d = edm_servo_step(&sv, &cfg, 0.5f, true, DT);
+    d = edm_servo_readvance(&sv, &cfg, retract, d, DT);
+    retract -= d;
+    v_prev = d / DT;
+  }
+  zassert_within(v_prev, 10.0f, 1e-3f, "At re-advance velocity");
+
+  // Short: slow down at max_acc, then follow the servo into retraction.
+  const float dv_max = cfg.max_acc * DT;
+  int ticks = 0;
+  while (sv.readvancing) {
+    float d = edm_servo_step(&sv, &cfg, -1, true, DT);
+    d = edm_servo_readvance(&sv, &cfg, retract, d, DT);
+    float v = d / DT;
+    zassert_true(fabsf(v - v_prev) <= dv_max + 1e-3f, "Acc limited at %d",
+                 ticks);
+    v_prev = v;
+    retract -= d;
+    ticks++;
+    zassert_true(ticks < 100, "Should hand over to servo");
+  }
+  zassert_true(ticks >= 10, "Ramped down over 10mm/s / 1000mm/s^2");
+  zassert_true(retract > cfg.slow_zone_mm, "Stopped before slow zone");
+
+  float d = edm_servo_step(&sv, &cfg, -1, true, DT);
+  zassert_equal(edm_servo_readvance(&sv, &cfg, retract, d, DT), d,
+                "Servo in control");
+  zassert_true(d < 0, "Retracting");
+}
+
+static const edm_esc_cfg_t ESC_CFG = {
+    .amplitude = 0.1f,
+    .period_s = 0.2f,
+    .gain = 0.05f,
+    .min_base = -0.5f,
+    .max_base = 0.5f,
+};
+
+// Simulate ESC with pulse rate (pulses/s) as a function of setpoint.
+static float run_esc(edm_esc_t* esc, float (*rate_of)(float), int ticks) {
+  uint32_t count = UINT32_MAX - 100;  // wraps around during run
+  float acc = 0;
+  edm_esc_init(esc, 0, count);
+  for (int i = 0; i < ticks; i++) {
+    float sp = edm_esc_step(esc, &ESC_CFG, count, DT);
+    acc += rate_of(sp) * DT;
+    count += (uint32_t)acc;
+    acc -= (uint32_t)acc;
+  }
+  return esc->base;
+}
+
+static float rate_peak_at_03(float sp) {
+  return 1000.0f - 2000.0f * (sp - 0.3f) * (sp - 0.3f);
+}
+
+static float rate_flat(float sp) {
+  return 500.0f;
+}
+
+static float rate_increasing(float sp) {
+  return 500.0f + 500.0f * sp;
+}
+
+ZTEST(edm_base, test_edm_esc_perturbation) {
+  edm_esc_t esc;
+  edm_esc_init(&esc, 0.1f, 0);
+  zassert_within(edm_esc_step(&esc, &ESC_CFG, 0, DT), 0.2f, 1e-6f,
+                 "Starts from high half");
+  for (int i = 0; i < 100; i++) {
+    edm_esc_step(&esc, &ESC_CFG, 0, DT);
+  }
+  zassert_within(edm_esc_step(&esc, &ESC_CFG, 0, DT), 0.0f, 1e-6f,
+                 "Low half after half period");
+  zassert_within(esc.base, 0.1f, 1e-6f, "No pulse: base unchanged");
+}
+
+ZTEST(edm_base, test_edm_esc_finds_peak) {
+  edm_esc_t esc;
+  float base = run_esc(&esc, rate_peak_at_03, 20000);
+  zassert_true(esc.cycles >= 99, "Completed cycles");
+  zassert_within(base, 0.3f, 0.06f, "Converges near peak");
+}
+
+ZTEST(edm_base, test_edm_esc_flat) {
+  edm_esc_t esc;
+  float base = run_esc(&esc, rate_flat, 20000);
+  zassert_within(base, 0.0f, 0.05f, "No gradient: stays");
+}
+
+ZTEST(edm_base, test_edm_esc_clamped) {
+  edm_esc_t esc;
+  float base = run_esc(&esc, rate_increasing, 40000);
+  zassert_within(base, ESC_CFG.max_base, 1e-6f, "Clamped to max");
+}
+
+ZTEST_SUITE(edm_base, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,119 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "gap_base.h"
+
+#include <zephyr/ztest.h>
+
+static const gap_cfg_t CFG = {
+    .alpha = 0.1f,
+    .enter_rate = 0.6f,
+    .exit_rate = 0.3f,
+    .arc_pulse_us = 800,
+    .arc_polls = 5,
+};
+
+// Normal machining: 1 pulse of 500us per poll, some open & short time.
+static const gap_poll_t POLL_NORMAL = {
+    .n_pulse = 1, .r_pulse = 128, .r_short = 25, .r_open = 100, .t_ign_us = 40};
+static const gap_poll_t POLL_SHORT = {
+    .n_pulse = 0, .r_pulse = 0, .r_short = 255, .r_open = 0};
+static const gap_poll_t POLL_OPEN = {
+    .n_pulse = 0, .r_pulse = 0, .r_short = 0, .r_open = 255};
+// Discharge for the whole poll without pulse completion.
+static const gap_poll_t POLL_ARC = {
+    .n_pulse = 0, .r_pulse = 255, .r_short = 0, .r_open = 0};
+
+ZTEST(gap_base, test_gap_first_sample) {
+  gap_est_t est;
+  gap_est_init(&est);
+  zassert_equal(est.state, GAP_NORMAL, "Initially normal");
+
+  gap_est_update(&est, &CFG, &POLL_NORMAL);
+  zassert_within(est.r_open, 100.0f, 1e-3f, "First sample taken as is");
+  zassert_within(est.t_ign_us, 40.0f, 1e-3f, "Ignition delay taken as is");
+  zassert_true(est.has_ign, "Has ignition delay");
+  zassert_equal(est.state, GAP_NORMAL, "Normal");
+}
+
+ZTEST(gap_base, test_gap_noise_rejected) {
+  gap_est_t est;
+  gap_est_init(&est);
+  for (int i = 0; i < 50; i++) {
+    gap_est_update(&est, &CFG, &POLL_NORMAL);
+  }
+
+  // A single shorted poll doesn't change state.
+  gap_est_update(&est, &CFG, &POLL_SHORT);
+  zassert_equal(est.state, GAP_NORMAL, "Single short poll is noise");
+  zassert_true(est.r_short < 255 * CFG.enter_rate, "Smoothed");
+  zassert_within(est.t_ign_us, 40.0f, 1e-3f, "No pulse: delay kept");
+}
+
+ZTEST(gap_base, test_gap_short_hysteresis) {
+  gap_est_t est;
+  gap_est_init(&est);
+  gap_est_update(&est, &CFG, &POLL_NORMAL);
+
+  int n = 0;
+  while (est.state != GAP_SHORT) {
+    gap_est_update(&est, &CFG, &POLL_SHORT);
+    n++;
+    zassert_true(n < 100, "Sustained short must be detected");
+  }
+  zassert_true(n > 1, "Needs multiple polls");
+
+  // Balanced gap (short 128) is between exit and enter: stays short.
+  gap_poll_t half = {.n_pulse = 1, .r_pulse = 0, .r_short = 128, .r_open = 0};
+  for (int i = 0; i < 100; i++) {
+    gap_est_update(&est, &CFG, &half);
+  }
+  zassert_equal(est.state, GAP_SHORT, "Within hysteresis band");
+
+  for (int i = 0; i < 100; i++) {
+    gap_est_update(&est, &CFG, &POLL_NORMAL);
+  }
+  zassert_equal(est.state, GAP_NORMAL, "Recovered");
+}
+
+ZTEST(gap_base, test_gap_open) {
+  gap_est_t est;
+  gap_est_init(&est);
+  for (int i = 0; i < 100; i++) {
+    gap_est_update(&est, &CFG, &POLL_OPEN);
+  }
+  zassert_equal(est.state, GAP_OPEN, "Open");
+  zassert_false(est.has_ign, "No pulse, no ignition delay");
+}
+
+ZTEST(gap_base, test_gap_arc) {
+  gap_est_t est;
+  gap_est_init(&est);
+  for (int i = 0; i < 50; i++) {
+    gap_est_update(&est, &CFG, &POLL_NORMAL);
+  }
+  zassert_equal(est.arc_count, 0, "500us per pulse is not arcing");
+
+  int n = 0;
+  while (est.state != GAP_ARC) {
+    gap_est_update(&est, &CFG, &POLL_ARC);
+    n++;
+    zassert_true(n < 100, "Sustained arc must be detected");
+  }
+  zassert_true(n >= CFG.arc_polls, "Needs sustained arcing");
+
+  // Arc takes precedence over short.
+  gap_est_update(&est, &CFG, &POLL_SHORT);
+  zassert_equal(est.state, GAP_ARC, "Still arc");
+
+  for (int i = 0; i < 100; i++) {
+    gap_est_update(&est, &CFG, &POLL_NORMAL);
+  }
+  zassert_equal(est.state, GAP_NORMAL, "Recovered");
+}
+
+ZTEST(gap_base, test_gap_state_name) {
+  zassert_str_equal(gap_state_name(GAP_ARC), "arc", "Name");
+  zassert_str_equal(gap_state_name(GAP_NORMAL), "normal", "Name");
+}
+
+ZTEST_SUITE(gap_base, NULL, NULL, NULL, NULL, NULL);
@@ -49,6 +49,19 @@ ZTEST(gcode_base, test_g1_with_coordinates) {
   zassert_equal(parsed.z, 5.0f, "Z should be 5.0");
 }
 
+ZTEST(gcode_base, test_g1_with_rotary_axes) {
+  gcode_parsed_t parsed;
+  bool result = parse_gcode("G1 X1 A0.25 B-2 C", &parsed);
+
+  zassert_true(result, "G1 with rotary axes should parse successfully");
+  zassert_equal(parsed.x_state, AXIS_WITH_VALUE, "X should have value");
+  zassert_equal(parsed.a_state, AXIS_WITH_VALUE, "A should have value");
+  zassert_equal(parsed.b_state, AXIS_WITH_VALUE, "B should have value");
+  zassert_equal(parsed.c_state, AXIS_ONLY, "C should be axis only");
+  zassert_equal(parsed.a, 0.25f, "A should be 0.25");
+  zassert_equal(parsed.b, -2.0f, "B should be -2.0");
+}
+
 ZTEST(gcode_base, test_g28_axis_only) {
   gcode_parsed_t parsed;
   bool result = parse_gcode("G28 X", &parsed);
@@ -63,6 +76,50 @@ ZTEST(gcode_base, test_g28_axis_only) {
                 "Z should not be specified");
 }
 
+ZTEST(gcode_base, test_is_path_move) {
+  gcode_parsed_t parsed;
+  const char* moves[] = {"G0 X1", "G1 X1", "G2 X1 R1", "G3 X1 R1",
+                         "G5 X1 I1 J1 P1 Q1"};
+  for (int i = 0; i < 5; i++) {
+    zassert_true(parse_gcode(moves[i], &parsed), "Should parse");
+    zassert_true(gcode_is_path_move(&parsed), "Path move");
+  }
+
+  const char* others[] = {"G28 X", "G38.2 X10", "G64", "M3"};
+  for (int i = 0; i < 4; i++) {
+    zassert_true(parse_gcode(others[i], &parsed), "Should parse");
+    zassert_false(gcode_is_path_move(&parsed), "Not a path move");
+  }
+}
+
+// G2/G3 arc parsing tests
+ZTEST(gcode_base, test_g2_with_center_offset) {
+  gcode_parsed_t parsed;
+  bool result = parse_gcode("G2 X10 Y0 I5 J-2.5", &parsed);
+
+  zassert_true(result, "G2 command should parse successfully");
+  zassert_equal(parsed.code, 2, "Code should be 2 for G2");
+  zassert_equal(parsed.x_state, AXIS_WITH_VALUE, "X should have value");
+  zassert_equal(parsed.i_state, PARAM_SPECIFIED, "I should be specified");
+  zassert_equal(parsed.j_state, PARAM_SPECIFIED, "J should be specified");
+  zassert_equal(parsed.k_state, PARAM_NOT_SPECIFIED,
+                "K should not be specified");
+  zassert_within(parsed.i, 5.0f, 0.001f, "I value should be 5");
+  zassert_within(parsed.j, -2.5f, 0.001f, "J value should be -2.5");
+}
+
+ZTEST(gcode_base, test_g3_with_radius) {
+  gcode_parsed_t parsed;
+  bool result = parse_gcode("G3 X1 Z2 R-3", &parsed);
+
+  zassert_true(result, "G3 command should parse successfully");
+  zassert_equal(parsed.code, 3, "Code should be 3 for G3");
+  zassert_equal(parsed.r_state, PARAM_SPECIFIED, "R should be specified");
+  zassert_within(parsed.r, -3.0f, 0.001f, "R value should be -3");
+  zassert_false(parse_gcode("G2 X1 I", &parsed),
+                "I without value should fail");
+}
+
 // M-code parsing tests
 ZTEST(gcode_base, test_basic_m3_command) {
   gcode_parsed_t parsed;
@@ -24,6 +24,25 @@ ZTEST(motion_base, test_posp_dist_3d) {
   zassert_within(posp_dist(&a, &b), sqrtf(3.0f), 1e-4f, "3D diagonal distance");
 }
 
+ZTEST(motion_base, test_posp_dist_rotary) {
+  pos_phys_t a = {0, 0, 0};
+  pos_phys_t b = {3, 0, 0, 0, 4, 0};  // X and B
+  zassert_within(posp_dist(&a, &b), 5.0f, 1e-4f, "Rotary axes count");
+}
+
+// Test posp_get() / posp_set()
+ZTEST(motion_base, test_posp_get_set) {
+  pos_phys_t p = {1, 2, 3, 4, 5, 6};
+  for (int i = 0; i < AXIS_COUNT; i++) {
+    zassert_equal(posp_get(&p, i), i + 1.0f, "Field order");
+    posp_set(&p, i, -i);
+  }
+  zassert_equal(p.x, 0.0f, "X set");
+  zassert_equal(p.c, -5.0f, "C set");
+  posp_set(&p, AXIS_COUNT, 99);
+  zassert_equal(posp_get(&p, AXIS_COUNT), 0.0f, "Invalid axis");
+}
+
 // Test posp_interp()
 ZTEST(motion_base, test_posp_interp_midpoint) {
   pos_phys_t a = {0, 0, 0};
@@ -57,6 +76,389 @@ ZTEST(motion_base, test_posp_interp_endpoints) {
   zassert_within(result.x, 4.0f, 1e-4f, "t=1 should be point b");
 }
 
+// Test arc_iter_t
+// Generate all arc points, checking they're on the circle & within tolerance.
+static void check_arc(arc_iter_t* it,
+                      float cx,
+                      float cy,
+                      float r,
+                      float tol,
+                      int* num_points,
+                      pos_phys_t* last) {
+  pos_phys_t prev = {0};
+  *num_points = 0;
+  pos_phys_t p;
+  while (arc_next(it, &p)) {
+    zassert_within(hypotf(p.x - cx, p.y - cy), r, 1e-4f,
+                   "Point should be on the circle");
+    if (*num_points > 0) {
+      // Chord midpoint deviation from the arc.
+      float mx = 0.5f * (p.x + prev.x) - cx;
+      float my = 0.5f * (p.y + prev.y) - cy;
+      zassert_true(r - hypotf(mx, my) <= tol + 1e-5f,
+                   "Chord should be within tolerance");
+    }
+    prev = p;
+    (*num_points)++;
+  }
+  *last = prev;
+}
+
+ZTEST(motion_base, test_arc_quarter_ccw) {
+  arc_iter_t it;
+  pos_phys_t start = {10, 0, 0};
+  pos_phys_t end = {0, 10, 0};
+  pos_phys_t center = {0, 0, 0};
+
+  zassert_true(arc_init(&it, &start, &end, &center, false, ARC_PLANE_XY,
+                        0.001f),
+               "Valid arc");
+  zassert_true(it.sweep > 0, "CCW should sweep positive");
+  zassert_within(it.sweep, (float)M_PI / 2, 1e-5f, "Quarter circle");
+
+  int num_points;
+  pos_phys_t last;
+  check_arc(&it, 0, 0, 10, 0.001f, &num_points, &last);
+  // chord angle: 2 * acos(1 - 0.001 / 10) = 0.02828 rad -> 56 chords
+  zassert_equal(num_points, 56, "Chord count from tolerance");
+  zassert_equal(last.x, end.x, "Should end exactly at end");
+  zassert_equal(last.y, end.y, "Should end exactly at end");
+}
+
+ZTEST(motion_base, test_arc_cw_long_way) {
+  arc_iter_t it;
+  pos_phys_t start = {10, 0, 0};
+  pos_phys_t end = {0, 10, 0};
+  pos_phys_t center = {0, 0, 0};
+
+  // CW from +X to +Y goes 3/4 around.
+  zassert_true(arc_init(&it, &start, &end, &center, true, ARC_PLANE_XY,
+                        0.01f),
+               "Valid arc");
+  zassert_within(it.sweep, -1.5f * (float)M_PI, 1e-5f, "3/4 circle CW");
+
+  pos_phys_t p;
+  arc_next(&it, &p);
+  zassert_true(p.y < 0, "CW should go towards -Y first");
+}
+
+ZTEST(motion_base, test_arc_full_circle_helix) {
+  arc_iter_t it;
+  pos_phys_t start = {1, 0, 0};
+  pos_phys_t end = {1, 0, -2};
+  pos_phys_t center = {0, 0, 0};
+
+  zassert_true(arc_init(&it, &start, &end, &center, false, ARC_PLANE_XY,
+                        0.001f),
+               "Valid arc");
+  zassert_within(it.sweep, 2 * (float)M_PI, 1e-5f, "Full circle");
+
+  int num_points;
+  pos_phys_t last;
+  check_arc(&it, 0, 0, 1, 0.001f, &num_points, &last);
+  zassert_equal(last.z, -2.0f, "Should end exactly at end");
+}
+
+ZTEST(motion_base, test_arc_rotary_linear) {
+  arc_iter_t it;
+  pos_phys_t start = {1, 0, 0, 0};
+  pos_phys_t end = {-1, 0, 0, 2};
+  pos_phys_t center = {0, 0, 0};
+
+  zassert_true(arc_init(&it, &start, &end, &center, false, ARC_PLANE_XY,
+                        0.001f),
+               "Valid arc");
+  pos_phys_t p;
+  int n = 0;
+  while (arc_next(&it, &p)) {
+    n++;
+    float t = (float)n / it.num_chords;
+    zassert_within(p.a, 2 * t, 1e-4f, "A moves linearly");
+    zassert_within(hypotf(p.x, p.y), 1.0f, 1e-4f, "XY on the circle");
+  }
+  zassert_equal(p.a, 2.0f, "Should end exactly at end");
+}
+
+ZTEST(motion_base, test_arc_invalid_radius) {
+  arc_iter_t it;
+  pos_phys_t start = {10, 0, 0};
+  pos_phys_t end = {0, 11, 0};
+  pos_phys_t center = {0, 0, 0};
+
+  zassert_false(arc_init(&it, &start, &end, &center, false, ARC_PLANE_XY,
+                         0.001f),
+                "Radius mismatch should be rejected");
+}
+
+ZTEST(motion_base, test_arc_center_from_radius) {
+  pos_phys_t start = {0, 0, 0};
+  pos_phys_t end = {10, 0, 0};
+  pos_phys_t center;
+
+  // CCW, short arc: center on the left (+Y) of start -> end.
+  zassert_true(arc_center_from_radius(&start, &end, 10, false, ARC_PLANE_XY,
+                                      &center),
+               "Valid radius");
+  zassert_within(center.x, 5.0f, 1e-4f, "Center X");
+  zassert_within(center.y, 8.660f, 1e-3f, "Center Y");
+
+  // CW or negative radius flips the side.
+  arc_center_from_radius(&start, &end, 10, true, ARC_PLANE_XY, &center);
+  zassert_within(center.y, -8.660f, 1e-3f, "Center Y for CW");
+  arc_center_from_radius(&start, &end, -10, false, ARC_PLANE_XY, &center);
+  zassert_within(center.y, -8.660f, 1e-3f, "Center Y for long arc");
+
+  // ZX plane: u=Z, v=X.
+  pos_phys_t end_z = {0, 0, 10};
+  arc_center_from_radius(&start, &end_z, 5, false, ARC_PLANE_ZX, &center);
+  zassert_within(center.z, 5.0f, 1e-4f, "Center Z");
+  zassert_within(center.x, 0.0f, 1e-4f, "Center X");
+
+  zassert_false(arc_center_from_radius(&start, &end, 4, false, ARC_PLANE_XY,
+                                       &center),
+                "Radius too small");
+}
+
+// Test bezier_iter_t
+// Point on the curve at t, by Bernstein polynomials.
+static pos_phys_t eval_bezier(const pos_phys_t* p, float t) {
+  float s = 1 - t;
+  float w[4] = {s * s * s, 3 * s * s * t, 3 * s * t * t, t * t * t};
+  pos_phys_t out = {0, 0, 0};
+  for (int i = 0; i < 4; i++) {
+    out.x += w[i] * p[i].x;
+    out.y += w[i] * p[i].y;
+    out.z += w[i] * p[i].z;
+  }
+  return out;
+}
+
+// Distance from p to segment a-b.
+static float dist_to_chord(pos_phys_t p, pos_phys_t a, pos_phys_t b) {
+  float len = posp_dist(&a, &b);
+  float t = ((p.x - a.x) * (b.x - a.x) + (p.y - a.y) * (b.y - a.y) +
+             (p.z - a.z) * (b.z - a.z)) /
+            (len * len);
+  pos_phys_t q;
+  posp_interp(&a, &b, fminf(fmaxf(t, 0), 1), &q);
+  return posp_dist(&p, &q);
+}
+
+// Generate all points, checking curve between points is within tol of chords.
+static void check_bezier(const pos_phys_t* p, float tol, int* num_points) {
+  bezier_iter_t it;
+  bezier_init(&it, &p[0], &p[1], &p[2], &p[3], tol);
+  pos_phys_t prev = p[0];
+  float t_prev = 0;
+  pos_phys_t pt;
+  *num_points = 0;
+  while (bezier_next(&it, &pt)) {
+    for (int i = 1; i < 8; i++) {
+      pos_phys_t c = eval_bezier(p, t_prev + (it.t - t_prev) * i / 8);
+      zassert_true(dist_to_chord(c, prev, pt) <= tol + 1e-5f,
+                   "Chord should be within tolerance");
+    }
+    prev = pt;
+    t_prev = it.t;
+    (*num_points)++;
+  }
+  zassert_equal(prev.x, p[3].x, "Should end exactly at end");
+  zassert_equal(prev.y, p[3].y, "Should end exactly at end");
+}
+
+ZTEST(motion_base, test_bezier_straight) {
+  pos_phys_t p[4] = {{0, 0, 0}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}};
+  int num_points;
+  check_bezier(p, 0.005f, &num_points);
+  zassert_equal(num_points, 1, "Straight curve should be a single chord");
+}
+
+ZTEST(motion_base, test_bezier_curve) {
+  pos_phys_t p[4] = {{0, 0, 0}, {0, 10, 0}, {10, 10, 1}, {10, 0, 1}};
+  int num_fine;
+  int num_coarse;
+  check_bezier(p, 0.005f, &num_fine);
+  check_bezier(p, 0.05f, &num_coarse);
+  zassert_true(num_coarse < num_fine, "Coarse tolerance needs less chords");
+  zassert_true(num_fine < 200, "Should not subdivide excessively");
+}
+
+// Test velocity profiles
+ZTEST(motion_base, test_vel_ramp_dist_trapezoid) {
+  vel_limits_t lim = {.max_vel = 100, .max_acc = 10, .max_jerk = 0};
+  // v^2 / 2a
+  zassert_within(vel_ramp_dist(&lim, 0, 10), 5.0f, 1e-4f, "Accel distance");
+  zassert_within(vel_ramp_dist(&lim, 10, 0), 5.0f, 1e-4f, "Decel distance");
+  zassert_within(vel_reachable(&lim, 0, 5.0f), 10.0f, 1e-3f,
+                 "Reachable velocity should invert ramp distance");
+  zassert_within(vel_reachable(&lim, 0, 1e6f), 100.0f, 1e-4f,
+                 "Reachable velocity should be capped by max_vel");
+}
+
+ZTEST(motion_base, test_vel_ramp_dist_scurve) {
+  vel_limits_t lim = {.max_vel = 100, .max_acc = 10, .max_jerk = 100};
+  // dv=10 >= a^2/j=1: t = dv/a + a/j = 1.1s, d = 5 * 1.1
+  zassert_within(vel_ramp_dist(&lim, 0, 10), 5.5f, 1e-4f, "Ramp distance");
+  // dv=0.25 < a^2/j: t = 2 * sqrt(dv/j) = 0.1s, d = 0.125 * 0.1
+  zassert_within(vel_ramp_dist(&lim, 0, 0.25f), 0.0125f, 1e-5f,
+                 "Triangular acceleration ramp distance");
+  zassert_within(vel_reachable(&lim, 0, 5.5f), 10.0f, 1e-3f,
+                 "Reachable velocity should invert ramp distance");
+  zassert_true(vel_ramp_dist(&lim, 0, 10) >
+                   vel_ramp_dist(&(vel_limits_t){100, 10, 0}, 0, 10),
+               "S-curve ramp should be longer than trapezoid");
+}
+
+// Run vel_step() until arrival. Checks invariants along the way.
+static void run_profile(const vel_limits_t* lim,
+                        float dist,
+                        int* ticks,
+                        float* v_peak) {
+  const float dt = 0.001f;
+  vel_state_t st = {0};
+  float d_remaining = dist;
+  *ticks = 0;
+  *v_peak = 0;
+  while (d_remaining > 0 && *ticks < 100000) {
+    float v_prev = st.vel;
+    float d = vel_step(&st, lim, d_remaining, 0, dt);
+    zassert_true(d > 0, "Should always make progress");
+    zassert_true(d <= d_remaining, "Should not overshoot");
+    zassert_true(st.vel <= lim->max_vel + 1e-3f, "Should not exceed max_vel");
+    zassert_true(st.vel - v_prev <= lim->max_acc * dt + 1e-3f,
+                 "Should not exceed max_acc when speeding up");
+    d_remaining -= d;
+    *v_peak = fmaxf(*v_peak, st.vel);
+    (*ticks)++;
+  }
+  zassert_within(st.vel, 0.0f, 1e-6f, "Should stop at the end");
+}
+
+ZTEST(motion_base, test_vel_step_trapezoid) {
+  vel_limits_t lim = {.max_vel = 50, .max_acc = 500, .max_jerk = 0};
+  int ticks;
+  float v_peak;
+  run_profile(&lim, 10.0f, &ticks, &v_peak);
+  zassert_within(v_peak, 50.0f, 1e-3f, "Should cruise at max_vel");
+  // 0.1s accel (2.5mm) + 0.1s cruise (5mm) + 0.1s decel (2.5mm)
+  zassert_within(ticks, 300, 5, "Should take time of trapezoid profile");
+}
+
+ZTEST(motion_base, test_vel_step_short_move) {
+  vel_limits_t lim = {.max_vel = 50, .max_acc = 500, .max_jerk = 0};
+  int ticks;
+  float v_peak;
+  run_profile(&lim, 0.5f, &ticks, &v_peak);
+  // triangular: v_peak = sqrt(a * d)
+  zassert_true(v_peak < 50.0f, "Should not reach max_vel in short move");
+  zassert_within(v_peak, sqrtf(500 * 0.5f), 1.0f, "Peak of triangle");
+}
+
+ZTEST(motion_base, test_vel_step_scurve) {
+  vel_limits_t trap = {.max_vel = 50, .max_acc = 500, .max_jerk = 0};
+  vel_limits_t scurve = {.max_vel = 50, .max_acc = 500, .max_jerk = 10000};
+  int ticks_trap, ticks_scurve;
+  float v_peak;
+  run_profile(&trap, 10.0f, &ticks_trap, &v_peak);
+  run_profile(&scurve, 10.0f, &ticks_scurve, &v_peak);
+  zassert_within(v_peak, 50.0f, 1e-3f, "Should cruise at max_vel");
+  zassert_true(ticks_scurve > ticks_trap, "S-curve should take longer");
+
+  // Acceleration must ramp up gradually.
+  vel_state_t st = {0};
+  vel_step(&st, &scurve, 10.0f, 0, 0.001f);
+  zassert_within(st.acc, 10.0f, 1e-3f, "First tick acc should be jerk * dt");
+}
+
+// Test velocity planning
+ZTEST(motion_base, test_posp_limit_along) {
+  pos_phys_t dir = {0.6f, 0.8f, 0};
+  pos_phys_t limits = {100, 200, 50};
+  // x: 100 / 0.6 = 166.7, y: 200 / 0.8 = 250, z: unconstrained
+  zassert_within(posp_limit_along(&dir, &limits), 166.67f, 0.01f,
+                 "Limited by x");
+
+  pos_phys_t dir_z = {0, 0, -1};
+  zassert_within(posp_limit_along(&dir_z, &limits), 50.0f, 1e-4f,
+                 "Limited by z");
+}
+
+ZTEST(motion_base, test_posp_junction_vel) {
+  plan_limits_t lim = {.max_vel = {100, 100, 100},
+                       .max_acc = {100, 100, 100},
+                       .max_jerk = 0,
+                       .junction_dev = 0.01f};
+  pos_phys_t a = {0, 0, 0};
+  pos_phys_t b = {1, 0, 0};
+  pos_phys_t c_straight = {2, 0, 0};
+  pos_phys_t c_reverse = {0.5f, 0, 0};
+  pos_phys_t c_corner = {1, 1, 0};
+
+  zassert_true(isinf(posp_junction_vel(&a, &b, &c_straight, &lim)),
+               "Straight");
+  zassert_within(posp_junction_vel(&a, &b, &c_reverse, &lim), 0.0f, 1e-6f,
+                 "Reversal");
+
+  // 90 deg: acc along diagonal is 141.4, r = 0.01 * 0.707 / (1 - 0.707)
+  zassert_within(posp_junction_vel(&a, &b, &c_corner, &lim), 1.848f, 0.01f,
+                 "90 deg corner");
+
+  lim.junction_dev = 0;
+  zassert_within(posp_junction_vel(&a, &b, &c_corner, &lim), 0.0f, 1e-6f,
+                 "Exact stop");
+}
+
+ZTEST(motion_base, test_plan_velocities) {
+  const vel_limits_t lim = {.max_vel = 100, .max_acc = 100, .max_jerk = 0};
+  plan_seg_t segs[3];
+  for (int i = 0; i < 3; i++) {
+    segs[i] = (plan_seg_t){
+        .len = 1, .lim = lim, .entry_max = INFINITY, .entry_vel = 0};
+  }
+  plan_velocities(segs, 3, 0);
+
+  // Accelerate through the first, decelerate through the last segment.
+  // sqrt(2 * 100 * 1) = 14.14
+  zassert_within(segs[0].entry_vel, 0.0f, 1e-6f, "Start");
+  zassert_within(segs[1].entry_vel, 14.14f, 0.01f, "Accel limited");
+  zassert_within(segs[2].entry_vel, 14.14f, 0.01f, "Decel limited");
+
+  // Corner limit propagates backward.
+  segs[2].entry_max = 1;
+  plan_velocities(segs, 3, 0);
+  zassert_within(segs[2].entry_vel, 1.0f, 1e-4f, "Corner limited");
+  zassert_within(segs[1].entry_vel, 14.14f, 0.01f, "Accel limited");
+}
+
+// Appending to a planned path must give the same result as planning it anew.
+ZTEST(motion_base, test_plan_velocities_append) {
+  const vel_limits_t lim = {.max_vel = 100, .max_acc = 100, .max_jerk = 1000};
+  const float entry_max[6] = {INFINITY, INFINITY, 2, INFINITY, 0, INFINITY};
+  plan_seg_t segs[6];
+  plan_seg_t fresh[6];
+  for (int i = 0; i < 6; i++) {
+    segs[i] = (plan_seg_t){
+        .len = 1, .lim = lim, .entry_max = entry_max[i], .entry_vel = 0};
+  }
+  for (int n = 2; n <= 6; n++) {
+    plan_velocities(segs, n, 0);
+    for (int i = 0; i < n; i++) {
+      fresh[i] = segs[i];
+      fresh[i].planned = false;
+      fresh[i].entry_vel = (i == 0) ? segs[0].entry_vel : 0;
+    }
+    plan_velocities(fresh, n, 0);
+    for (int i = 0; i < n; i++) {
+      zassert_equal(segs[i].entry_vel, fresh[i].entry_vel,
+                    "entry_vel of %d/%d", i, n);
+      zassert_equal(segs[i].brake_vel, fresh[i].brake_vel,
+                    "brake_vel of %d/%d", i, n);
+      zassert_equal(segs[i].brake_dist, fresh[i].brake_dist,
+                    "brake_dist of %d/%d", i, n);
+    }
+  }
+}
+
 // Test path_buffer_t initialization
 ZTEST(motion_base, test_pb_init_basic) {
   path_buffer_t pb;
@@ -111,6 +513,12 @@ ZTEST(motion_base, test_pb_move_backward) {
   pos_phys_t pos = pb_get_pos(&pb);
   zassert_within(pos.x, 0.3f, EDM_RESOLUTION_MM + 1e-4f,
                  "Should be at 0.3mm after retraction");
+  zassert_within(pb_get_retract(&pb), 0.2f, EDM_RESOLUTION_MM + 1e-4f,
+                 "Retracted by 0.2mm");
+
+  // Re-advancing beyond the furthest point clears retraction.
+  pb_move(&pb, 0.3f);
+  zassert_equal(pb_get_retract(&pb), 0.0f, "No longer retracted");
 }
 
 ZTEST(motion_base, test_pb_move_retraction_limit) {
@@ -120,13 +528,65 @@ ZTEST(motion_base, test_pb_move_retraction_limit) {
 
   pb_init(&pb, &src, &dst, true);
 
-  // Move forward much more than history size can track
-  // EDM_HISTORY_SIZE=201, EDM_RESOLUTION_MM=0.005, so max history ~1mm
-  pb_move(&pb, 5.0f);  // Move 5mm forward (way beyond history)
+  pb_move(&pb, 5.0f);  // Move 5mm forward
+
+  // Multi-mm retraction within traveled path is allowed.
+  zassert_true(pb_move(&pb, -3.0f), "Long retraction should succeed");
+  pos_phys_t pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 2.0f, EDM_RESOLUTION_MM + 1e-4f, "Should be at 2mm");
 
   // Try to retract way beyond limit - should fail
   zassert_false(pb_move(&pb, -10.0f),
                 "Retraction beyond history limit should fail");
+  pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 0.0f, 1e-6f, "Should be clipped to the start");
+}
+
+ZTEST(motion_base, test_pb_move_retraction_limit_segments) {
+  path_buffer_t pb;
+  pos_phys_t src = {0, 0, 0};
+  pos_phys_t dst = {0.1f, 0, 0};
+
+  // Staircase of 0.1mm segments, longer than retained history.
+  pb_init(&pb, &src, &dst, false);
+  int num_segs = 1;
+  for (int i = 0; i < PB_HISTORY_SEGS + 10; i++) {
+    pos_phys_t p = dst;
+    if (i % 2 == 0) {
+      p.y += 0.1f;
+    } else {
+      p.x += 0.1f;
+    }
+    if (!pb_can_write(&pb)) {
+      pb_move(&pb, 0.1f);
+    }
+    pb_write(&pb, &p, false);
+    dst = p;
+    num_segs++;
+  }
+  pb_move(&pb, 100.0f);
+  zassert_true(pb_at_tail(&pb), "Should reach the tail");
+
+  // Retract through all retained segments.
+  float retractable = (PB_HISTORY_SEGS + 1) * 0.1f;
+  zassert_true(pb_move(&pb, -(retractable - 0.01f)),
+               "Retraction through retained segments should succeed");
+  zassert_false(pb_move(&pb, -0.1f), "Retraction beyond should fail");
+
+  // Position should be at the start of the oldest retained segment.
+  int n_lost = num_segs - (PB_HISTORY_SEGS + 1);
+  pos_phys_t pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 0.1f * ((n_lost + 1) / 2), 1e-4f,
+                 "Should be at oldest retained point");
+  zassert_within(pos.y, 0.1f * (n_lost / 2), 1e-4f,
+                 "Should be at oldest retained point");
+
+  // Forward again returns to the tail.
+  pb_move(&pb, 100.0f);
+  zassert_true(pb_at_tail(&pb), "Should be back at the tail");
+  pos = pb_get_pos(&pb);
+  zassert_within(pos.x, dst.x, 1e-6f, "Should be back at the tail");
+  zassert_within(pos.y, dst.y, 1e-6f, "Should be back at the tail");
 }
 
 ZTEST(motion_base, test_pb_move_to_end) {
@@ -166,26 +626,455 @@ ZTEST(motion_base, test_pb_write_and_traverse) {
                  "Y should be halfway up");
 }
 
+// Two consecutive G1 lines: second is written while moving along the first.
+// Motion stops when pb_at_tail(), so it must not happen until the very end.
+ZTEST(motion_base, test_pb_write_while_moving) {
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0};
+  pos_phys_t p2 = {1, 0, 0};
+  pos_phys_t p3 = {2, 1, 0};
+
+  pb_init(&pb, &p1, &p2, false);
+  pb_set_notch(&pb, EDM_RESOLUTION_MM, 1.0f);
+  for (int i = 0; i < 100; i++) {
+    pb_move(&pb, 0.005f);  // EDM servo speed
+  }
+  zassert_false(pb_at_tail(&pb), "Still moving along first line");
+  pb_write(&pb, &p3, false);
+
+  int ticks = 0;
+  while (!pb_at_tail(&pb)) {
+    pb_move(&pb, 0.005f);
+    ticks++;
+    zassert_true(ticks < 1000, "Should reach the tail");
+  }
+  pos_phys_t pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 2.0f, 1e-4f, "Stopped only at end of second line");
+  zassert_within(pos.y, 1.0f, 1e-4f, "Stopped only at end of second line");
+}
+
 ZTEST(motion_base, test_pb_write_buffer_full) {
   path_buffer_t pb;
   pos_phys_t p1 = {0, 0, 0};
   pos_phys_t p2 = {1, 0, 0};
-  pos_phys_t p3 = {2, 0, 0};
 
   pb_init(&pb, &p1, &p2, false);
-  pb_write(&pb, &p3, false);  // Fill the buffer
+  for (int i = 0; i < PB_QUEUE_SIZE; i++) {
+    zassert_true(pb_can_write(&pb), "Should be able to write until full");
+    pos_phys_t p = {2 + i, 0, 0};
+    pb_write(&pb, &p, false);  // Fill the buffer
+  }
 
-  zassert_false(pb_can_write(&pb), "Buffer should be full after one write");
+  zassert_false(pb_can_write(&pb),
+                "Buffer should be full after PB_QUEUE_SIZE writes");
   zassert_true(pb_is_ready(&pb),
                "If can't write, must be ready (buffer populated)");
 
-  // Move to consume the buffered segment
+  // Move to consume the first buffered segment
   pb_move(&pb, 1.1f);  // Move past first segment
 
   zassert_true(pb_can_write(&pb),
                "Should be able to write after consuming buffer");
 }
 
+ZTEST(motion_base, test_pb_queue_wrap_around) {
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0};
+  pos_phys_t p2 = {0.1f, 0, 0};
+
+  pb_init(&pb, &p1, &p2, false);
+
+  // Stream 0.1mm segments along X, consuming while writing, so that the queue
+  // wraps around several times.
+  int num_written = 1;
+  for (int i = 0; i < PB_QUEUE_SIZE * 3; i++) {
+    while (pb_can_write(&pb)) {
+      num_written++;
+      pos_phys_t p = {num_written * 0.1f, 0, 0};
+      pb_write(&pb, &p, false);
+    }
+    zassert_equal(pb.num_queue, PB_QUEUE_SIZE, "Queue should be full");
+    pb_move(&pb, 0.1f);
+  }
+
+  pos_phys_t pos = pb_get_pos(&pb);
+  zassert_within(pos.x, PB_QUEUE_SIZE * 3 * 0.1f, EDM_RESOLUTION_MM + 1e-4f,
+                 "Should have moved through all consumed segments");
+  zassert_false(pb_at_tail(&pb), "Should not be at tail with queued points");
+
+  // Drain everything written so far.
+  pb_move(&pb, num_written * 0.1f);
+  pos = pb_get_pos(&pb);
+  zassert_within(pos.x, num_written * 0.1f, EDM_RESOLUTION_MM + 1e-4f,
+                 "Should stop at last written point");
+  zassert_true(pb_at_tail(&pb), "Should be at tail after draining");
+  zassert_false(pb_at_end(&pb), "Should not be at end (end not written)");
+}
+
+ZTEST(motion_base, test_pb_retract_across_segments) {
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0};
+  pos_phys_t p2 = {0.2f, 0, 0};
+  pos_phys_t p3 = {0.2f, 0.2f, 0};
+  pos_phys_t p4 = {0.4f, 0.2f, 0};
+  pos_phys_t p5 = {0.4f, 0.4f, 0};  // staircase path
+
+  pb_init(&pb, &p1, &p2, false);
+  pb_write(&pb, &p3, false);
+  pb_write(&pb, &p4, false);
+  pb_write(&pb, &p5, true);
+
+  // Move to the middle of the last segment.
+  pb_move(&pb, 0.7f);
+  pos_phys_t pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 0.4f, EDM_RESOLUTION_MM + 1e-4f, "X on last segment");
+  zassert_within(pos.y, 0.3f, EDM_RESOLUTION_MM + 1e-4f, "Y on last segment");
+
+  // Retract back through two corners, into the second segment.
+  zassert_true(pb_move(&pb, -0.4f), "Retraction should succeed");
+  pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 0.2f, EDM_RESOLUTION_MM + 1e-4f,
+                 "X on second segment");
+  zassert_within(pos.y, 0.1f, EDM_RESOLUTION_MM + 1e-4f,
+                 "Y on second segment");
+  zassert_false(pb_at_end(&pb), "Should not be at end while retracted");
+
+  // Advance again through history, then to the end.
+  pb_move(&pb, 0.2f);
+  pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 0.3f, EDM_RESOLUTION_MM + 1e-4f, "X on third segment");
+  zassert_within(pos.y, 0.2f, EDM_RESOLUTION_MM + 1e-4f, "Y on third segment");
+
+  pb_move(&pb, 1.0f);
+  zassert_true(pb_at_end(&pb), "Should reach the end");
+  pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 0.4f, 1e-4f, "X at end");
+  zassert_within(pos.y, 0.4f, 1e-4f, "Y at end");
+}
+
+// Staircase of 0.1mm segments from (0, 0). Returns the last point.
+static pos_phys_t write_staircase(path_buffer_t* pb, int num_segs) {
+  pos_phys_t src = {0, 0, 0};
+  pos_phys_t dst = {0.1f, 0, 0};
+  pb_init(pb, &src, &dst, false);
+  for (int i = 1; i < num_segs; i++) {
+    pos_phys_t p = dst;
+    if (i % 2 == 1) {
+      p.y += 0.1f;
+    } else {
+      p.x += 0.1f;
+    }
+    if (!pb_can_write(pb)) {
+      pb_move(pb, 0.1f);
+    }
+    pb_write(pb, &p, false);
+    dst = p;
+  }
+  pb_move(pb, 100.0f);
+  return dst;
+}
+
+ZTEST(motion_base, test_pb_write_while_retracted) {
+  path_buffer_t pb;
+  pos_phys_t tail = write_staircase(&pb, PB_HISTORY_SEGS + 11);
+  zassert_true(pb_at_tail(&pb), "Should reach the tail");
+  zassert_equal(pb.num_seg_history, PB_HISTORY_SEGS, "History should be full");
+
+  // Retract into the oldest retained segment.
+  zassert_true(pb_move(&pb, -(PB_HISTORY_SEGS + 0.5f) * 0.1f),
+               "Retraction into oldest segment should succeed");
+  pos_phys_t retracted = pb_get_pos(&pb);
+
+  // Appending must not evict history the retraction reaches into.
+  pos_phys_t next = tail;
+  next.z += 0.1f;
+  pb_write(&pb, &next, false);
+  pos_phys_t pos = pb_get_pos(&pb);
+  zassert_within(pos.x, retracted.x, 1e-6f, "Position should not change");
+  zassert_within(pos.y, retracted.y, 1e-6f, "Position should not change");
+
+  // Further retraction reaches the oldest point, never moves forward.
+  zassert_false(pb_move(&pb, -0.1f), "Retraction beyond should fail");
+  pos = pb_get_pos(&pb);
+  zassert_true(pos.x + pos.y <= retracted.x + retracted.y + 1e-6f,
+               "Retraction should not move forward");
+
+  // Forward reaches the new point.
+  pb_move(&pb, 100.0f);
+  zassert_true(pb_at_tail(&pb), "Should reach the tail");
+  pos = pb_get_pos(&pb);
+  zassert_within(pos.x, next.x, 1e-6f, "Should reach the new point");
+  zassert_within(pos.y, next.y, 1e-6f, "Should reach the new point");
+  zassert_within(pos.z, next.z, 1e-6f, "Should reach the new point");
+}
+
+ZTEST(motion_base, test_pb_history_limited_by_max_retract) {
+  path_buffer_t pb;
+  pos_phys_t src = {0, 0, 0};
+  pos_phys_t dst = {0.1f, 0, 0};
+
+  pb_init(&pb, &src, &dst, false);
+  pb_set_notch(&pb, 0.001f, 0.25f);
+  for (int i = 1; i < 20; i++) {
+    pos_phys_t p = dst;
+    p.x += 0.1f;
+    pb_write(&pb, &p, false);
+    dst = p;
+    pb_move(&pb, 100.0f);
+  }
+
+  // Only segments within max_retract are retained.
+  zassert_true(pb.num_seg_history <= 3, "History beyond max_retract dropped");
+  zassert_true(pb_move(&pb, -0.25f), "Retraction within limit");
+  zassert_within(pb_get_pos(&pb).x, dst.x - 0.25f, 0.001f + 1e-4f,
+                 "Should retract by max_retract");
+}
+
+ZTEST(motion_base, test_pb_dist_to_seg_end) {
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0};
+  pos_phys_t p2 = {1, 0, 0};
+  pos_phys_t p3 = {1, 1, 0};
+
+  pb_init(&pb, &p1, &p2, false);
+  pb_move(&pb, 0.3f);
+  zassert_within(pb_dist_to_seg_end(&pb), 0.7f, 1e-4f,
+                 "Should count remaining distance in segment");
+
+  // Remaining distance not aligned to notches.
+  pb_init(&pb, &p1, &(pos_phys_t){0.502f, 0, 0}, true);
+  pb_move(&pb, 0.5f);
+  zassert_false(pb_at_end(&pb), "Should not be at end yet");
+  pb_move(&pb, pb_dist_to_seg_end(&pb));
+  zassert_true(pb_at_end(&pb), "Should reach end by moving remaining dist");
+
+  // Clipped at the end, then extended.
+  pb_init(&pb, &p1, &p2, false);
+  pb_move(&pb, 0.3f);
+  pb_move(&pb, 1.0f);
+  zassert_within(pb_dist_to_seg_end(&pb), 0.0f, 1e-6f, "Should be at end");
+  pb_write(&pb, &p3, true);
+  zassert_within(pb_dist_to_seg_end(&pb), 1.0f, 1e-4f,
+                 "Should continue to the written segment");
+}
+
+ZTEST(motion_base, test_pb_brake_target) {
+  plan_limits_t lim = {.max_vel = {30, 30, 30},
+                       .max_acc = {300, 300, 300},
+                       .max_jerk = 0,
+                       .junction_dev = 0.01f};
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0};
+  pos_phys_t p2 = {1, 0, 0};
+  pos_phys_t p3 = {2, 0, 0};
+  pos_phys_t p4 = {2, 1, 0};
+  pos_phys_t p5 = {2, 0.5f, 0};
+  float v;
+
+  pb_init(&pb, &p1, &p2, false);
+  pb_set_limits(&pb, &lim);
+  zassert_within(pb_brake_target(&pb, &v), 1.0f, 1e-4f, "Path ends at p2");
+  zassert_within(v, 0.0f, 1e-6f, "Must stop at tail");
+  zassert_within(pb_seg_limits(&pb)->max_acc, 300.0f, 1e-3f,
+                 "Single axis acc");
+
+  pb_write(&pb, &p3, false);
+  zassert_within(pb_brake_target(&pb, &v), 2.0f, 1e-4f,
+                 "Straight: brake over both segments");
+  zassert_within(v, 0.0f, 1e-6f, "Must stop at tail");
+
+  pb_write(&pb, &p4, false);
+  zassert_within(pb_brake_target(&pb, &v), 2.0f, 1e-4f, "Corner at p3");
+  zassert_within(v, 3.200f, 0.01f, "90 deg corner velocity");
+
+  pb_write(&pb, &p5, true);
+  pb_move(&pb, 1.5f);
+  zassert_within(pb_brake_target(&pb, &v), 0.5f, 1e-4f, "Corner at p3");
+
+  pb_move(&pb, 1.0f);
+  zassert_within(pb_brake_target(&pb, &v), 0.5f, 1e-4f, "Reversal at p4");
+  zassert_within(v, 0.0f, 1e-6f, "Must stop at reversal");
+}
+
+ZTEST(motion_base, test_pb_axis_vel_limits) {
+  plan_limits_t lim = {.max_vel = {10, 10, 50},
+                       .max_acc = {100, 100, 500},
+                       .max_jerk = 0,
+                       .junction_dev = 0};
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0};
+  pos_phys_t p2 = {0, 0, 1};
+  pos_phys_t p3 = {1, 1, 1};
+  pos_phys_t p4 = {2, 1, 1};
+
+  pb_init(&pb, &p1, &p2, false);
+  pb_set_limits(&pb, &lim);
+  pb_write(&pb, &p3, false);
+  pb_write(&pb, &p4, true);
+  zassert_within(pb_seg_limits(&pb)->max_vel, 50.0f, 1e-3f, "Fast Z axis");
+  zassert_within(pb_seg_limits(&pb)->max_acc, 500.0f, 1e-3f, "Fast Z axis");
+
+  pb_move(&pb, 1.0f);
+  zassert_within(pb_seg_limits(&pb)->max_vel, 14.142f, 1e-3f,
+                 "Diagonal is faster than each axis");
+  zassert_within(pb_seg_limits(&pb)->max_acc, 141.42f, 1e-2f,
+                 "Diagonal is faster than each axis");
+
+  pb_move(&pb, 1.5f);
+  zassert_within(pb_seg_limits(&pb)->max_vel, 10.0f, 1e-3f, "Slow X axis");
+}
+
+ZTEST(motion_base, test_pb_rotary_axis) {
+  plan_limits_t lim = {.max_vel = {10, 10, 10, 1, 1, 1},
+                       .max_acc = {100, 100, 100, 10, 10, 10},
+                       .max_jerk = 0,
+                       .junction_dev = 0};
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0, 0};
+  pos_phys_t p2 = {1, 0, 0, 1};
+
+  pb_init(&pb, &p1, &p2, true);
+  pb_set_limits(&pb, &lim);
+  zassert_within(pb_seg_limits(&pb)->max_vel, 1.4142f, 1e-3f,
+                 "Limited by slow A axis");
+
+  pb_move(&pb, sqrtf(2) / 2);
+  pos_phys_t pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 0.5f, EDM_RESOLUTION_MM, "X halfway");
+  zassert_within(pos.a, pos.x, 1e-5f, "A moves in sync");
+}
+
+ZTEST(motion_base, test_pb_blend_corner) {
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0};
+  pos_phys_t p2 = {1, 0, 0};
+  pos_phys_t corner = {2, 0, 0};
+  pos_phys_t p4 = {2, 1, 0};
+
+  pb_init(&pb, &p1, &p2, false);
+  pb_set_blend_tol(&pb, 0.01f);
+  pb_write(&pb, &corner, false);
+  pb_write(&pb, &p4, true);
+
+  // Traverse whole path, tracking distance to the corner.
+  float min_dist = 1e9f;
+  for (int i = 0; i < 4000 && !pb_at_end(&pb); i++) {
+    pb_move(&pb, 0.001f);
+    pos_phys_t pos = pb_get_pos(&pb);
+    min_dist = fminf(min_dist, posp_dist(&pos, &corner));
+  }
+  zassert_true(pb_at_end(&pb), "Should reach end");
+  pos_phys_t pos = pb_get_pos(&pb);
+  zassert_within(pos.x, 2.0f, 1e-4f, "Should end at p4");
+  zassert_within(pos.y, 1.0f, 1e-4f, "Should end at p4");
+  zassert_true(min_dist > 0.005f, "Corner should be blended");
+  // Measured at notches, so allow error of one notch.
+  zassert_true(min_dist < 0.01f + EDM_RESOLUTION_MM,
+               "Blend should be within tolerance");
+}
+
+ZTEST(motion_base, test_pb_blend_reserves_queue) {
+  path_buffer_t pb;
+  pos_phys_t src = {0, 0, 0};
+  pos_phys_t dst = {1, 0, 0};
+
+  pb_init(&pb, &src, &dst, false);
+  pb_set_blend_tol(&pb, 0.01f);
+  int num_written = 0;
+  while (pb_can_write(&pb) && num_written < PB_QUEUE_SIZE) {
+    // zig-zag, so that every corner is blended
+    pos_phys_t p = {2 + num_written, (num_written % 2) ? 1 : 0, 0};
+    pb_write(&pb, &p, false);
+    num_written++;
+  }
+  zassert_true(num_written < PB_QUEUE_SIZE,
+               "Blending should leave room for arcs");
+  zassert_true(pb.num_queue <= PB_QUEUE_SIZE, "Queue should not overflow");
+  zassert_true(pb.num_queue > num_written, "Arcs should be added to queue");
+}
+
+// Notch positions are computed from fixed-point distance, so they're exact
+// multiples of EDM_RESOLUTION_MM (no drift even on long segments).
+ZTEST(motion_base, test_pb_move_notch_positions_exact) {
+  path_buffer_t pb;
+  pos_phys_t src = {0, 0, 0};
+  pos_phys_t dst = {128, 0, 0};
+
+  pb_init(&pb, &src, &dst, true);
+  int num_notches = (int)(128 / EDM_RESOLUTION_MM);
+  for (int k = 1; k <= num_notches; k++) {
+    pb_move(&pb, EDM_RESOLUTION_MM);
+    zassert_equal(pb_get_pos(&pb).x, k * EDM_RESOLUTION_MM,
+                  "Notch position should be exact");
+  }
+  zassert_true(pb_at_end(&pb), "Should reach end");
+  zassert_equal(pb_get_pos(&pb).x, 128.0f, "Should end exactly at dst");
+}
+
+ZTEST(motion_base, test_pb_move_notch_positions_across_segments) {
+  path_buffer_t pb;
+  pos_phys_t p1 = {0, 0, 0};
+  pos_phys_t p2 = {2.5f * EDM_RESOLUTION_MM, 0, 0};  // 2.5 notches
+  pos_phys_t p3 = {2.5f * EDM_RESOLUTION_MM, 1, 0};
+
+  pb_init(&pb, &p1, &p2, false);
+  pb_write(&pb, &p3, true);
+  for (int k = 1; k <= 10; k++) {
+    pb_move(&pb, EDM_RESOLUTION_MM);
+    pos_phys_t pos = pb_get_pos(&pb);
+    if (k <= 2) {
+      zassert_equal(pos.x, k * EDM_RESOLUTION_MM, "On first segment");
+      zassert_equal(pos.y, 0.0f, "On first segment");
+    } else {
+      // Remaining half notch carries over to the second segment.
+      zassert_equal(pos.x, p2.x, "On second segment");
+      zassert_equal(pos.y, (k - 2.5f) * EDM_RESOLUTION_MM,
+                    "On second segment");
+    }
+  }
+}
+
+ZTEST(motion_base, test_pb_move_notch_positions_diagonal) {
+  path_buffer_t pb;
+  pos_phys_t src = {0, 0, 0};
+  pos_phys_t dst = {3, 4, 0};  // length 5
+
+  pb_init(&pb, &src, &dst, true);
+  for (int k = 1; k <= 1000; k++) {
+    pb_move(&pb, EDM_RESOLUTION_MM);
+    pos_phys_t pos = pb_get_pos(&pb);
+    zassert_within(pos.x, 0.6f * k * EDM_RESOLUTION_MM, 1e-6f, "x");
+    zassert_within(pos.y, 0.8f * k * EDM_RESOLUTION_MM, 1e-6f, "y");
+  }
+  zassert_true(pb_at_end(&pb), "Should reach end");
+  zassert_equal(pb_get_pos(&pb).y, 4.0f, "Should end exactly at dst");
+}
+
+ZTEST(motion_base, test_pb_set_notch) {
+  path_buffer_t pb;
+  pos_phys_t src = {0, 0, 0};
+  pos_phys_t dst = {1, 0, 0};
+
+  pb_init(&pb, &src, &dst, true);
+  pb_set_notch(&pb, 0.001f, 0.01f);
+
+  // Fine notch: positions are multiples of 1um.
+  for (int k = 1; k <= 100; k++) {
+    pb_move(&pb, 0.001f);
+    zassert_equal(pb_get_pos(&pb).x, k * 0.001f,
+                  "Notch position should be exact");
+  }
+  pb_move(&pb, 0.0025f);
+  zassert_equal(pb_get_pos(&pb).x, 102 * 0.001f,
+                "Should advance by whole notches");
+
+  // Retraction is limited by max_retract_mm.
+  zassert_true(pb_move(&pb, -0.0095f), "Retraction within limit");
+  zassert_false(pb_move(&pb, -0.002f), "Retraction beyond limit should fail");
+  zassert_within(pb_get_pos(&pb).x, 0.092f, 1e-6f,
+                 "Should be clipped to max retraction");
+}
+
 // Test edge cases
 ZTEST(motion_base, test_pb_tiny_movements) {
   path_buffer_t pb;
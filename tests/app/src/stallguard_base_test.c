@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "stallguard_base.h"
+
+#include <zephyr/ztest.h>
+
+ZTEST(stallguard_base, test_sg_sweep_empty) {
+  sg_sweep_t sw;
+  sg_sweep_init(&sw);
+  zassert_equal(sw.thresh, 0, "Sweep starts from least sensitive");
+  zassert_equal(sg_sweep_result(&sw, 1.0f), -1, "No sample, no result");
+
+  // Read errors don't count as samples.
+  zassert_true(sg_sweep_update(&sw, -5, false), "Should retry");
+  zassert_equal(sw.thresh, 0, "Threshold unchanged after error");
+  zassert_equal(sg_sweep_result(&sw, 1.0f), -1, "Still no result");
+}
+
+ZTEST(stallguard_base, test_sg_sweep_false_stall) {
+  sg_sweep_t sw;
+  sg_sweep_init(&sw);
+
+  // Free running at SG_RESULT ~200: stall is reported from thresh > 100.
+  int samples = 0;
+  while (true) {
+    bool stalled = 200 < 2 * sw.thresh;
+    samples++;
+    if (!sg_sweep_update(&sw, 200, stalled)) {
+      break;
+    }
+  }
+  zassert_equal(samples, 100 / SG_SWEEP_STEP + 2, "Ends at first stall");
+  zassert_equal(sw.clean_thresh, 100, "Highest clean threshold");
+  zassert_equal(sw.sg_min, 200, "Min SG_RESULT");
+  zassert_equal(sg_sweep_result(&sw, 1.0f), 100, "No margin");
+  zassert_equal(sg_sweep_result(&sw, 0.8f), 80, "With margin");
+}
+
+ZTEST(stallguard_base, test_sg_sweep_limited_by_sg_min) {
+  sg_sweep_t sw;
+  sg_sweep_init(&sw);
+
+  // Load dips are not always caught by diag; SG_RESULT limits the result.
+  zassert_true(sg_sweep_update(&sw, 300, false), "Continue");
+  zassert_true(sg_sweep_update(&sw, 60, false), "Continue");
+  zassert_true(sg_sweep_update(&sw, 300, false), "Continue");
+  zassert_equal(sw.clean_thresh, 2 * SG_SWEEP_STEP, "Clean so far");
+  zassert_equal(sg_sweep_result(&sw, 1.0f), 2 * SG_SWEEP_STEP,
+                "Limited by clean threshold");
+
+  for (int i = 0; i < 20; i++) {
+    sg_sweep_update(&sw, 300, false);
+  }
+  zassert_equal(sg_sweep_result(&sw, 1.0f), 30, "Limited by min SG_RESULT");
+}
+
+ZTEST(stallguard_base, test_sg_sweep_full_range) {
+  sg_sweep_t sw;
+  sg_sweep_init(&sw);
+
+  int samples = 0;
+  while (sg_sweep_update(&sw, 510, false)) {
+    samples++;
+  }
+  samples++;
+  zassert_equal(samples, SG_SWEEP_MAX_SAMPLES, "Sweeps whole range");
+  zassert_true(sw.clean_thresh <= SG_THRESH_MAX, "Within register range");
+  zassert_equal(sg_sweep_result(&sw, 1.0f), sw.clean_thresh,
+                "Limited by range");
+}
+
+ZTEST_SUITE(stallguard_base, NULL, NULL, NULL, NULL, NULL);
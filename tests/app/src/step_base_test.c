@@ -0,0 +1,152 @@
+// SPDX-FileCopyrightText: 2025 夕月霞
+// SPDX-License-Identifier: AGPL-3.0-or-later
+#include "step_base.h"
+
+#include <math.h>
+#include <zephyr/ztest.h>
+
+#define MIN_INTERVAL STEP_TIME_TICKS(4)
+
+ZTEST(step_base, test_step_run_time) {
+  step_run_t run = {.first = 100, .interval = 30, .count = 3, .dir = true};
+  zassert_equal(step_run_time(&run, 0), 100, "First step");
+  zassert_equal(step_run_time(&run, 2), 160, "Third step");
+
+  // Times wrap around
+  run.first = UINT32_MAX - 9;
+  zassert_equal(step_run_time(&run, 1), 20, "Wrapped step");
+}
+
+ZTEST(step_base, test_step_queue) {
+  step_queue_t q;
+  step_queue_init(&q);
+  zassert_true(step_queue_empty(&q), "Initially empty");
+  zassert_is_null(step_queue_peek(&q), "Nothing to peek");
+
+  for (int i = 0; i < STEP_QUEUE_SIZE; i++) {
+    step_run_t run = {.first = i, .interval = 1, .count = 1, .dir = true};
+    zassert_true(step_queue_push(&q, &run), "Push should succeed");
+  }
+  step_run_t extra = {.first = 99, .interval = 1, .count = 1, .dir = true};
+  zassert_true(step_queue_full(&q), "Queue should be full");
+  zassert_false(step_queue_push(&q, &extra), "Push to full queue should fail");
+
+  for (int i = 0; i < STEP_QUEUE_SIZE; i++) {
+    const step_run_t* run = step_queue_peek(&q);
+    zassert_not_null(run, "Run should be available");
+    zassert_equal(run->first, i, "Runs should come out in order");
+    step_queue_pop(&q);
+  }
+  zassert_true(step_queue_empty(&q), "All runs consumed");
+  zassert_true(step_queue_push(&q, &extra), "Push after wrap-around");
+  zassert_equal(step_queue_peek(&q)->first, 99, "Wrapped-around run");
+}
+
+ZTEST(step_base, test_step_gen_constant_velocity) {
+  step_gen_t gen;
+  step_run_t run;
+  step_gen_init(&gen, 0, MIN_INTERVAL);
+  step_gen_sync(&gen, 1000);
+
+  // 10 steps in 100 ticks: crossings at 0.5, 1.5, ... 9.5
+  zassert_true(step_gen_move(&gen, 10.0f, 1000, STEP_TIME_TICKS(100), &run),
+               "Should step");
+  zassert_true(run.dir, "Positive direction");
+  zassert_equal(run.count, 10, "10 steps");
+  zassert_equal(run.first, 1000 + STEP_TIME_TICKS(5), "First step at 0.5");
+  zassert_equal(run.interval, STEP_TIME_TICKS(10), "Evenly spaced");
+  zassert_equal(gen.pos, 10, "Position after steps");
+}
+
+ZTEST(step_base, test_step_gen_slow) {
+  step_gen_t gen;
+  step_run_t run;
+  step_gen_init(&gen, 0, MIN_INTERVAL);
+  step_gen_sync(&gen, 0);
+  uint32_t period = STEP_TIME_TICKS(100);
+
+  // 0.3 microsteps per period: no step in 1st period.
+  zassert_false(step_gen_move(&gen, 0.3f, 0, period, &run), "Before 0.5");
+  // Crosses 0.5 at 2/3 of the 2nd period.
+  zassert_true(step_gen_move(&gen, 0.6f, period, period, &run), "Crosses");
+  zassert_equal(run.count, 1, "Single step");
+  zassert_within((int)run.first, (int)(period + period * 2 / 3), 1,
+                 "Step at the crossing");
+  zassert_false(step_gen_move(&gen, 0.9f, 2 * period, period, &run),
+                "Already at 1");
+}
+
+ZTEST(step_base, test_step_gen_reverse) {
+  step_gen_t gen;
+  step_run_t run;
+  step_gen_init(&gen, 5, MIN_INTERVAL);
+  step_gen_sync(&gen, 0);
+  uint32_t period = STEP_TIME_TICKS(100);
+
+  zassert_true(step_gen_move(&gen, 2.0f, 0, period, &run), "Should step");
+  zassert_false(run.dir, "Negative direction");
+  zassert_equal(run.count, 3, "3 steps");
+  // crossings at 4.5, 3.5, 2.5 of 5 -> 2
+  zassert_within((int)run.first, (int)(period / 6), 1, "First crossing");
+  zassert_within((int)run.interval, (int)(period / 3), 1, "Spacing");
+  zassert_equal(gen.pos, 2, "Position after steps");
+}
+
+ZTEST(step_base, test_step_gen_min_interval) {
+  step_gen_t gen;
+  step_run_t run;
+  step_gen_init(&gen, 0, MIN_INTERVAL);
+  step_gen_sync(&gen, 0);
+  uint32_t period = STEP_TIME_TICKS(10);
+
+  // 10 steps in 10 ticks is faster than min interval.
+  zassert_true(step_gen_move(&gen, 10.0f, 0, period, &run), "Should step");
+  zassert_equal(run.interval, MIN_INTERVAL, "Limited by min interval");
+  uint32_t last = step_run_time(&run, run.count - 1);
+
+  // Next move must keep min interval from the previous steps.
+  zassert_true(step_gen_move(&gen, 11.0f, period, period, &run),
+               "Should step");
+  zassert_equal(run.first, last + MIN_INTERVAL, "Delayed by min interval");
+}
+
+ZTEST(step_base, test_step_gen_asap) {
+  step_gen_t gen;
+  step_run_t run;
+  step_gen_init(&gen, 0, MIN_INTERVAL);
+  step_gen_sync(&gen, 0);
+
+  zassert_true(step_gen_move(&gen, 3.0f, 500, 0, &run), "Should step");
+  zassert_equal(run.first, 500, "Starts immediately");
+  zassert_equal(run.interval, MIN_INTERVAL, "At max rate");
+  zassert_equal(run.count, 3, "3 steps");
+}
+
+ZTEST(step_base, test_step_gen_follows_position) {
+  // Steps generated over many periods should match rounded target positions.
+  step_gen_t gen;
+  step_run_t run;
+  step_gen_init(&gen, 0, MIN_INTERVAL);
+  step_gen_sync(&gen, 0);
+  uint32_t period = STEP_TIME_TICKS(200);
+
+  int pos = 0;
+  uint32_t last = 0;
+  for (int i = 1; i <= 200; i++) {
+    float t = i * 0.01f;
+    float target = 100 * t * t;  // accelerating
+    if (step_gen_move(&gen, target, (i - 1) * period, period, &run)) {
+      zassert_true((int32_t)(run.first - last) > 0, "Time must advance");
+      zassert_true((int32_t)(run.first - (i - 1) * period) >= 0,
+                   "Not before the period");
+      zassert_true((int32_t)(step_run_time(&run, run.count - 1) -
+                             i * period) <= 0,
+                   "Not after the period");
+      pos += run.dir ? run.count : -run.count;
+      last = step_run_time(&run, run.count - 1);
+    }
+    zassert_equal(pos, (int)floorf(target + 0.5f), "Should track target");
+  }
+}
+
+ZTEST_SUITE(step_base, NULL, NULL, NULL, NULL, NULL);
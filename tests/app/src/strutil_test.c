@@ -147,4 +147,38 @@ ZTEST(strutil, test_parse_float_invalid) {
   zassert_false(parse_float("12.3", NULL), "Should reject NULL output");
 }
 
+ZTEST(strutil, test_parse_stream_line) {
+  int seq;
+  char* cmd;
+
+  char line1[] = ":12 G1 X1";
+  zassert_true(parse_stream_line(line1, &seq, &cmd), "Stream command");
+  zassert_equal(seq, 12, "Sequence number");
+  zassert_str_equal(cmd, "G1 X1", "Command");
+
+  char line2[] = "::";
+  zassert_true(parse_stream_line(line2, &seq, &cmd), "End of stream");
+  zassert_equal(seq, 0, "End of stream has seq 0");
+  zassert_is_null(cmd, "No command");
+
+  char line3[] = "G1 X1";
+  zassert_false(parse_stream_line(line3, &seq, &cmd), "Not a stream line");
+}
+
+ZTEST(strutil, test_parse_stream_line_malformed) {
+  int seq;
+  char* cmd;
+
+  char line1[] = ":x G1";
+  zassert_true(parse_stream_line(line1, &seq, &cmd), "Stream line");
+  zassert_equal(seq, -1, "Bad number");
+  char line2[] = ":0 G1";
+  zassert_true(parse_stream_line(line2, &seq, &cmd), "Stream line");
+  zassert_equal(seq, -1, "Sequence starts from 1");
+  char line3[] = ":3";
+  zassert_true(parse_stream_line(line3, &seq, &cmd), "Stream line");
+  zassert_equal(seq, -1, "No command");
+  zassert_is_null(cmd, "No command");
+}
+
 ZTEST_SUITE(strutil, NULL, NULL, NULL, NULL, NULL);